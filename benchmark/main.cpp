@@ -0,0 +1,474 @@
+// Stand-alone benchmark for the CPU processing stages. Runs every kernel for
+// every instruction set and thread count over synthetic or recorded frames
+// and prints ns/pixel, frames/s and the memory bandwidth the kernel moves.
+//
+//   make && ./kinectbench [options]
+//
+//   --recording file.kv2   depth and IR planes from a recording instead of
+//                          the synthetic scene (colour stays synthetic
+//                          unless built with TURBOJPEG=1)
+//   --threads 1,2,4        thread counts, default 1 and powers of two up to
+//                          the hardware thread count
+//   --isa sse2             only this instruction set, default all supported
+//   --kernel depth         only kernels whose name contains this
+//   --seconds 0.5          measuring time per row
+//   --csv                  comma separated output for tracking releases
+
+#include "PixelKernels.h"
+#include "ColourScaler.h"
+#include "DepthFusion.h"
+#include "DepthCodec.h"
+#include "DepthMapping.h"
+#include "KinectRecording.h"
+#include "PointCloud.h"
+#include "Registration.h"
+#include "SpatialFilter.h"
+#include "SyntheticScene.h"
+#include "TemporalFilter.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+    const int DEPTH_PIXELS = SyntheticScene::DEPTH_WIDTH * SyntheticScene::DEPTH_HEIGHT;
+    const int COLOR_PIXELS = SyntheticScene::COLOR_WIDTH * SyntheticScene::COLOR_HEIGHT;
+    const int NUM_FRAMES = 8;
+
+    struct Options {
+        string recording;
+        vector<int> threads;
+        string isa;
+        string kernel;
+        double seconds = 0.5;
+        bool csv = false;
+        bool help = false;
+    };
+
+    // input frames, several so the caches see a stream like the real thing
+    struct Frames {
+        vector<vector<float>> depth;
+        vector<vector<float>> ir;
+        vector<vector<unsigned char>> color;
+    };
+
+    struct Kernel {
+        string name;
+        size_t pixels;
+        // bytes read and written per pixel
+        size_t bytesPerPixel;
+        // processes pixels [begin, end) of frame i
+        function<void(int frame, size_t begin, size_t end)> run;
+        // kernels that can't be split by range, like JPEG, run on one thread
+        bool parallel;
+        // PixelKernels, run once per instruction set
+        bool usesIsa;
+        // filters that split a whole frame over the pool themselves, used
+        // instead of run when set
+        function<void(int frame, WorkerPool& pool)> runPooled;
+    };
+
+    void printUsage(FILE* out, const char* name)
+    {
+        fprintf(out, "usage: %s [--recording file.kv2] [--threads 1,2,4] [--isa name] [--kernel name] [--seconds s] [--csv]\n", name);
+        fprintf(out, "  --recording  frames from a recording instead of the synthetic scene\n");
+        fprintf(out, "  --threads    thread counts to run the parallel kernels with, 1 up to every core by default\n");
+        fprintf(out, "  --isa        only this instruction set: scalar, sse2, avx2 or neon\n");
+        fprintf(out, "  --kernel     only kernels whose name contains this, e.g. depth/ or colour/\n");
+        fprintf(out, "  --seconds    time per kernel, 0.5 by default\n");
+        fprintf(out, "  --csv        comma separated output\n");
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--recording" && hasValue) {
+                options.recording = argv[++i];
+            }
+            else if (arg == "--threads" && hasValue) {
+                stringstream list(argv[++i]);
+                string item;
+                while (getline(list, item, ',')) {
+                    options.threads.push_back(max(1, atoi(item.c_str())));
+                }
+            }
+            else if (arg == "--isa" && hasValue) {
+                options.isa = argv[++i];
+            }
+            else if (arg == "--kernel" && hasValue) {
+                options.kernel = argv[++i];
+            }
+            else if (arg == "--seconds" && hasValue) {
+                options.seconds = atof(argv[++i]);
+            }
+            else if (arg == "--csv") {
+                options.csv = true;
+            }
+            else if (arg == "--help") {
+                options.help = true;
+            }
+            else {
+                fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (options.threads.empty()) {
+            int hardware = max(1u, thread::hardware_concurrency());
+            for (int threads = 1; threads < hardware; threads *= 2) {
+                options.threads.push_back(threads);
+            }
+            options.threads.push_back(hardware);
+        }
+        return true;
+    }
+
+    bool loadFrames(const Options& options, Frames& frames)
+    {
+        frames.depth.assign(NUM_FRAMES, vector<float>(DEPTH_PIXELS));
+        frames.ir.assign(NUM_FRAMES, vector<float>(DEPTH_PIXELS));
+        frames.color.assign(NUM_FRAMES, vector<unsigned char>(COLOR_PIXELS * 4));
+
+        SyntheticScene scene;
+        for (int i = 0; i < NUM_FRAMES; i++) {
+            scene.renderDepth(i, frames.depth[i].data());
+            scene.renderIr(frames.depth[i].data(), frames.ir[i].data());
+            scene.renderColor(i, frames.color[i].data());
+        }
+        if (options.recording.empty()) {
+            return true;
+        }
+
+        KinectRecording::Reader reader;
+        if (!reader.open(options.recording)) {
+            fprintf(stderr, "could not open recording %s\n", options.recording.c_str());
+            return false;
+        }
+        const KinectRecording::FileHeader& header = reader.getHeader();
+        if (header.depthWidth * header.depthHeight != (uint32_t)DEPTH_PIXELS) {
+            fprintf(stderr, "unexpected depth size in %s\n", options.recording.c_str());
+            return false;
+        }
+#ifdef HAVE_TURBOJPEG
+        tjhandle decompressor = tjInitDecompress();
+#endif
+        for (int i = 0; i < NUM_FRAMES; i++) {
+            KinectRecording::FrameView view = reader.getFrame(i % reader.getFrameCount());
+            if (view.depth) {
+                memcpy(frames.depth[i].data(), view.depth, DEPTH_PIXELS * sizeof(float));
+            }
+            if (view.ir) {
+                memcpy(frames.ir[i].data(), view.ir, DEPTH_PIXELS * sizeof(float));
+            }
+#ifdef HAVE_TURBOJPEG
+            if (view.jpeg && header.colorWidth * header.colorHeight == (uint32_t)COLOR_PIXELS) {
+                tjDecompress2(decompressor, view.jpeg, view.jpegSize, frames.color[i].data(), header.colorWidth, 0, header.colorHeight, TJPF_RGBA, TJFLAG_FASTDCT);
+            }
+#endif
+        }
+#ifdef HAVE_TURBOJPEG
+        tjDestroy(decompressor);
+#endif
+        return true;
+    }
+
+    // output buffers are shared by every kernel and sized for the largest
+    struct Outputs {
+        vector<unsigned char> bytes = vector<unsigned char>(COLOR_PIXELS * 4);
+        vector<float> floats = vector<float>(DEPTH_PIXELS);
+        vector<unsigned short> shorts = vector<unsigned short>(DEPTH_PIXELS);
+        // each frame's depth in mm and RVL encoded
+        vector<vector<uint16_t>> millimetres;
+        vector<vector<unsigned char>> rvl;
+        vector<size_t> rvlSizes;
+#ifdef HAVE_TURBOJPEG
+        vector<vector<unsigned char>> jpegs;
+        vector<unsigned long> jpegSizes;
+        tjhandle compressor = tjInitCompress();
+        tjhandle decompressor = tjInitDecompress();
+        ~Outputs() { tjDestroy(compressor); tjDestroy(decompressor); }
+#endif
+    };
+
+    vector<Kernel> makeKernels(Frames& frames, Outputs& out, DepthMapping& mapping, TemporalFilter& temporal, SpatialFilter (&spatial)[SpatialFilter::FILTER_COUNT], PointCloud& points, Registration& registration, ColourScaler& scaler, DepthFusion& fusion)
+    {
+        vector<Kernel> kernels;
+
+        kernels.push_back({ "depth/grey", DEPTH_PIXELS, 5, [&](int f, size_t b, size_t e) {
+            PixelKernels::depthToGrey(frames.depth[f].data() + b, out.bytes.data() + b, e - b);
+        }, true, true, nullptr });
+        kernels.push_back({ "depth/unit", DEPTH_PIXELS, 8, [&](int f, size_t b, size_t e) {
+            PixelKernels::depthToUnit(frames.depth[f].data() + b, out.floats.data() + b, e - b);
+        }, true, true, nullptr });
+        kernels.push_back({ "depth/lut/grey", DEPTH_PIXELS, 6, [&](int f, size_t b, size_t e) {
+            PixelKernels::lookupGrey(frames.depth[f].data() + b, mapping.getGreyTable(), out.bytes.data() + b, e - b);
+        }, true, true, nullptr });
+        kernels.push_back({ "depth/lut/unit", DEPTH_PIXELS, 12, [&](int f, size_t b, size_t e) {
+            PixelKernels::lookupUnit(frames.depth[f].data() + b, mapping.getUnitTable(), out.floats.data() + b, e - b);
+        }, true, true, nullptr });
+        kernels.push_back({ "depth/millimetres", DEPTH_PIXELS, 6, [&](int f, size_t b, size_t e) {
+            PixelKernels::depthToMillimetres(frames.depth[f].data() + b, out.shorts.data() + b, e - b);
+        }, true, true, nullptr });
+        // reads mm, writes the encoded frame
+        for (int i = 0; i < NUM_FRAMES; i++) {
+            out.millimetres.push_back(vector<uint16_t>(DEPTH_PIXELS));
+            PixelKernels::depthToMillimetres(frames.depth[i].data(), out.millimetres[i].data(), DEPTH_PIXELS);
+            out.rvl.push_back(vector<unsigned char>(DepthCodec::getMaxEncodedSize(DEPTH_PIXELS)));
+            out.rvlSizes.push_back(DepthCodec::encode(out.millimetres[i].data(), DEPTH_PIXELS, out.rvl[i].data()));
+        }
+        kernels.push_back({ "depth/rvl/encode", DEPTH_PIXELS, 3, [&](int f, size_t, size_t) {
+            DepthCodec::encode(out.millimetres[f].data(), DEPTH_PIXELS, out.bytes.data());
+        }, false, false, nullptr });
+        kernels.push_back({ "depth/rvl/decode", DEPTH_PIXELS, 3, [&](int f, size_t, size_t) {
+            DepthCodec::decode(out.rvl[f].data(), out.rvlSizes[f], out.shorts.data(), DEPTH_PIXELS);
+        }, false, false, nullptr });
+        kernels.push_back({ "depth/pack16", DEPTH_PIXELS, 8, [&](int f, size_t b, size_t e) {
+            PixelKernels::packDepth16(frames.depth[f].data() + b, out.bytes.data() + b * 4, e - b);
+        }, true, true, nullptr });
+        // reads depth and the smoothed state, writes the state, output and age
+        kernels.push_back({ "depth/temporal", DEPTH_PIXELS, 14, [&](int f, size_t b, size_t e) {
+            temporal.apply(frames.depth[f].data(), out.floats.data(), b, e);
+        }, true, false, nullptr });
+        // each spatial filter on its own, bytes are the padded copy and the filter pass
+        for (int i = 0; i < SpatialFilter::FILTER_COUNT; i++) {
+            SpatialFilter& filter = spatial[i];
+            Kernel kernel = { "depth/" + SpatialFilter::getFilterName((SpatialFilter::Type)i), DEPTH_PIXELS, 16, nullptr, true, false, nullptr };
+            kernel.runPooled = [&](int f, WorkerPool& pool) {
+                filter.apply(frames.depth[f].data(), frames.ir[f].data(), out.floats.data(), &pool);
+            };
+            kernels.push_back(kernel);
+        }
+        kernels.push_back({ "depth/points", DEPTH_PIXELS, 20, [&](int f, size_t, size_t) {
+            points.unproject(frames.depth[f].data(), (float*)out.bytes.data());
+        }, false, false, nullptr });
+        // every sensor's points to world space and into the height map,
+        // bytes are the depth, the points and the sorted map entries
+        Kernel fuse = { "depth/fusion", (size_t)(DEPTH_PIXELS * fusion.getSensorCount()), 28, nullptr, true, false, nullptr };
+        fuse.runPooled = [&](int f, WorkerPool& pool) {
+            for (int i = 0; i < fusion.getSensorCount(); i++) {
+                fusion.setDepth(i, frames.depth[(f + i) % NUM_FRAMES].data(), false);
+            }
+            fusion.process(&pool, true);
+        };
+        kernels.push_back(fuse);
+        // reads depth and the colour it lands on, writes the registered pixel
+        Kernel registerColour = { "colour/register", DEPTH_PIXELS, 12, nullptr, true, false, nullptr };
+        registerColour.runPooled = [&](int f, WorkerPool& pool) {
+            registration.registerColor(frames.depth[f].data(), frames.color[f].data(), out.bytes.data(), &pool);
+        };
+        kernels.push_back(registerColour);
+        // per colour pixel, clearing and splatting the colour sized depth
+        kernels.push_back({ "depth/colourspace", COLOR_PIXELS, 4, [&](int f, size_t, size_t) {
+            registration.mapDepth(frames.depth[f].data(), (float*)out.bytes.data());
+        }, false, false, nullptr });
+        kernels.push_back({ "ir/grey", DEPTH_PIXELS, 5, [&](int f, size_t b, size_t e) {
+            PixelKernels::irToGrey(frames.ir[f].data() + b, out.bytes.data() + b, e - b);
+        }, true, true, nullptr });
+        kernels.push_back({ "ir/unit", DEPTH_PIXELS, 8, [&](int f, size_t b, size_t e) {
+            PixelKernels::irToUnit(frames.ir[f].data() + b, out.floats.data() + b, e - b);
+        }, true, true, nullptr });
+        // what the capture thread does with every colour frame
+        // halves, quarters and eighths in one pass, bytes are the source and
+        // everything written
+        Kernel scaleColour = { "colour/scaled", COLOR_PIXELS, 6, nullptr, true, false, nullptr };
+        scaleColour.runPooled = [&](int f, WorkerPool& pool) {
+            scaler.process(frames.color[f].data(), 1, &pool);
+        };
+        kernels.push_back(scaleColour);
+        kernels.push_back({ "colour/copy", COLOR_PIXELS, 8, [&](int f, size_t b, size_t e) {
+            memcpy(out.bytes.data() + b * 4, frames.color[f].data() + b * 4, (e - b) * 4);
+        }, true, false, nullptr });
+
+#ifdef HAVE_TURBOJPEG
+        // the recorder's encode and the playback decode, one frame per call
+        out.jpegs.assign(NUM_FRAMES, vector<unsigned char>(tjBufSize(1920, 1080, TJSAMP_420)));
+        out.jpegSizes.assign(NUM_FRAMES, 0);
+        for (int i = 0; i < NUM_FRAMES; i++) {
+            unsigned char* buffer = out.jpegs[i].data();
+            tjCompress2(out.compressor, frames.color[i].data(), 1920, 0, 1080, TJPF_RGBA, &buffer, &out.jpegSizes[i], TJSAMP_420, 90, TJFLAG_FASTDCT | TJFLAG_NOREALLOC);
+        }
+        kernels.push_back({ "colour/jpeg/encode", COLOR_PIXELS, 4, [&](int f, size_t, size_t) {
+            unsigned char* buffer = out.bytes.data();
+            unsigned long size = out.bytes.size();
+            tjCompress2(out.compressor, frames.color[f].data(), 1920, 0, 1080, TJPF_RGBA, &buffer, &size, TJSAMP_420, 90, TJFLAG_FASTDCT | TJFLAG_NOREALLOC);
+        }, false, false, nullptr });
+        kernels.push_back({ "colour/jpeg/decode", COLOR_PIXELS, 4, [&](int f, size_t, size_t) {
+            tjDecompress2(out.decompressor, out.jpegs[f].data(), out.jpegSizes[f], out.bytes.data(), 1920, 0, 1080, TJPF_RGBA, TJFLAG_FASTDCT);
+        }, false, false, nullptr });
+        // scaled while decoding, what playback does when only reduced colour
+        // outputs are wanted, per decoded pixel
+        for (int divisor = 2; divisor <= 8; divisor *= 2) {
+            kernels.push_back({ "colour/jpeg/decode/" + to_string(divisor), (size_t)(COLOR_PIXELS / (divisor * divisor)), 4, [&, divisor](int f, size_t, size_t) {
+                tjDecompress2(out.decompressor, out.jpegs[f].data(), out.jpegSizes[f], out.bytes.data(), 1920 / divisor, 0, 1080 / divisor, TJPF_RGBA, TJFLAG_FASTDCT);
+            }, false, false, nullptr });
+        }
+#endif
+
+        return kernels;
+    }
+
+    // mean time per frame in ns
+    double measure(const Kernel& kernel, WorkerPool& pool, double seconds)
+    {
+        int frame = 0;
+        auto runFrame = [&] {
+            if (kernel.runPooled) {
+                kernel.runPooled(frame, pool);
+            }
+            else if (kernel.parallel) {
+                pool.parallelFor(kernel.pixels, [&](size_t begin, size_t end) { kernel.run(frame, begin, end); });
+            }
+            else {
+                kernel.run(frame, 0, kernel.pixels);
+            }
+            frame = (frame + 1) % NUM_FRAMES;
+        };
+
+        // warm up caches, page in the outputs and let the clocks settle
+        for (int i = 0; i < NUM_FRAMES * 2; i++) {
+            runFrame();
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        chrono::steady_clock::time_point end = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+        uint64_t count = 0;
+        chrono::steady_clock::time_point now;
+        do {
+            runFrame();
+            count++;
+            now = chrono::steady_clock::now();
+        } while (now < end);
+
+        return chrono::duration<double, nano>(now - start).count() / count;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(stderr, argv[0]);
+        return 1;
+    }
+    if (options.help) {
+        printUsage(stdout, argv[0]);
+        return 0;
+    }
+
+    Frames frames;
+    if (!loadFrames(options, frames)) {
+        return 1;
+    }
+    Outputs outputs;
+    DepthMapping mapping;
+    mapping.update();
+    TemporalFilter temporal;
+    temporal.setup(SyntheticScene::DEPTH_WIDTH, SyntheticScene::DEPTH_HEIGHT);
+    SpatialFilter spatial[SpatialFilter::FILTER_COUNT];
+    for (int i = 0; i < SpatialFilter::FILTER_COUNT; i++) {
+        spatial[i].setup(SyntheticScene::DEPTH_WIDTH, SyntheticScene::DEPTH_HEIGHT);
+        spatial[i].setEnabled((SpatialFilter::Type)i, true);
+    }
+    PointCloud points;
+    points.setup(SyntheticScene::DEPTH_WIDTH, SyntheticScene::DEPTH_HEIGHT, PointCloud::Intrinsics());
+    Registration registration;
+    registration.setCalibration(Registration::Calibration());
+    ColourScaler scaler;
+    scaler.setup(SyntheticScene::COLOR_WIDTH, SyntheticScene::COLOR_HEIGHT);
+    scaler.addScale(2);
+    scaler.addScale(4);
+    scaler.addScale(8);
+    // four sensors around an 8 m square floor, a metre up, facing the middle
+    DepthFusion fusion;
+    DepthFusion::Area area;
+    area.minX = area.minY = -4.0f;
+    area.maxX = area.maxY = 4.0f;
+    fusion.setup(4, SyntheticScene::DEPTH_WIDTH, SyntheticScene::DEPTH_HEIGHT, area);
+    const float positions[4][2] = { { 0, -3 }, { 3, 0 }, { 0, 3 }, { -3, 0 } };
+    for (int i = 0; i < 4; i++) {
+        DepthFusion::Pose pose;
+        pose.x = positions[i][0];
+        pose.y = positions[i][1];
+        pose.z = 1.0f;
+        pose.yaw = i * 90.0f;
+        pose.pitch = -10.0f;
+        fusion.setSensor(i, PointCloud::Intrinsics(), pose);
+    }
+    vector<Kernel> kernels = makeKernels(frames, outputs, mapping, temporal, spatial, points, registration, scaler, fusion);
+
+    vector<PixelKernels::Isa> isas;
+    for (int i = 0; i < PixelKernels::ISA_COUNT; i++) {
+        PixelKernels::Isa isa = (PixelKernels::Isa)i;
+        if (PixelKernels::isSupported(isa) && (options.isa.empty() || PixelKernels::getIsaName(isa) == options.isa)) {
+            isas.push_back(isa);
+        }
+    }
+    if (isas.empty()) {
+        fprintf(stderr, "instruction set %s is unknown or not supported here, supported:", options.isa.c_str());
+        for (int i = 0; i < PixelKernels::ISA_COUNT; i++) {
+            if (PixelKernels::isSupported((PixelKernels::Isa)i)) {
+                fprintf(stderr, " %s", PixelKernels::getIsaName((PixelKernels::Isa)i).c_str());
+            }
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    if (options.csv) {
+        printf("kernel,isa,threads,ns_per_pixel,frames_per_second,gb_per_second\n");
+    }
+    else {
+        printf("%-20s %-7s %7s %12s %12s %10s\n", "kernel", "isa", "threads", "ns/pixel", "frames/s", "GB/s");
+    }
+
+    for (int threads : options.threads) {
+        WorkerPool pool(threads);
+        for (const Kernel& kernel : kernels) {
+            if (kernel.name.find(options.kernel) == string::npos || (!kernel.parallel && threads != options.threads.front())) {
+                continue;
+            }
+            for (PixelKernels::Isa isa : isas) {
+                PixelKernels::setIsa(isa);
+                string isaName = kernel.usesIsa ? PixelKernels::getIsaName(isa) : "-";
+
+                double frameTime = measure(kernel, pool, options.seconds);
+                double nsPerPixel = frameTime / kernel.pixels;
+                double framesPerSecond = 1e9 / frameTime;
+                double bandwidth = kernel.bytesPerPixel * kernel.pixels / frameTime;
+                int threadCount = kernel.parallel ? threads : 1;
+
+                if (options.csv) {
+                    printf("%s,%s,%d,%.4f,%.1f,%.3f\n", kernel.name.c_str(), isaName.c_str(), threadCount, nsPerPixel, framesPerSecond, bandwidth);
+                }
+                else {
+                    printf("%-20s %-7s %7d %12.4f %12.1f %10.3f\n", kernel.name.c_str(), isaName.c_str(), threadCount, nsPerPixel, framesPerSecond, bandwidth);
+                }
+                fflush(stdout);
+
+                if (!kernel.usesIsa) {
+                    break;
+                }
+            }
+        }
+    }
+
+    PixelKernels::setIsa(PixelKernels::getBestIsa());
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "BackgroundModel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    
+    const char FILE_MAGIC[8] = { 'K', 'V', '2', 'B', 'G', 0, 0, 0 };
+    
+}
+
+void BackgroundModel::setup(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    background.assign(width * height, 0.0f);
+    learned = false;
+}
+
+void BackgroundModel::learn(int frames)
+{
+    learnFrames = std::min(std::max(frames, 1), (int)MAX_LEARN_FRAMES);
+    learnedFrames = 0;
+    window.resize((size_t)learnFrames * width * height);
+}
+
+float BackgroundModel::getLearningProgress() const
+{
+    return learnFrames > 0 ? (float)learnedFrames / learnFrames : 1.0f;
+}
+
+void BackgroundModel::add(const float* depth)
+{
+    if (!isLearning()) {
+        return;
+    }
+    // pixel major, so each pixel's history is contiguous for the median
+    size_t count = width * height;
+    uint16_t* history = window.data() + learnedFrames;
+    for (size_t i = 0; i < count; i++) {
+        float value = std::min(std::max(depth[i], 0.0f), 65535.0f);
+        history[i * learnFrames] = (uint16_t)value;
+    }
+    if (++learnedFrames == learnFrames) {
+        finishLearning();
+    }
+}
+
+void BackgroundModel::finishLearning()
+{
+    size_t count = width * height;
+    for (size_t i = 0; i < count; i++) {
+        uint16_t* history = window.data() + i * learnFrames;
+        uint16_t* end = std::remove(history, history + learnFrames, 0);
+        size_t valid = end - history;
+        if (!valid) {
+            background[i] = 0;
+        }
+        else if (mode == MODE_FARTHEST) {
+            background[i] = *std::max_element(history, end);
+        }
+        else {
+            std::nth_element(history, history + valid / 2, end);
+            background[i] = history[valid / 2];
+        }
+    }
+    learned = true;
+    learnFrames = 0;
+    learnedFrames = 0;
+    // a minute of history is tens of MB, don't hold on to it
+    std::vector<uint16_t>().swap(window);
+}
+
+void BackgroundModel::foreground(const float* depth, unsigned char* mask, unsigned char* rgba) const
+{
+    size_t count = width * height;
+    const float* model = background.data();
+    for (size_t i = 0; i < count; i++) {
+        float value = depth[i];
+        bool isForeground = learned && value > 0 && model[i] > 0 && value < model[i] - threshold;
+        if (mask) {
+            mask[i] = isForeground ? 255 : 0;
+        }
+        if (rgba) {
+            unsigned int mm = isForeground ? (unsigned int)std::min(value, 65535.0f) : 0;
+            rgba[i * 4] = mm >> 8;
+            rgba[i * 4 + 1] = mm & 0xff;
+            rgba[i * 4 + 2] = isForeground ? 255 : 0;
+            rgba[i * 4 + 3] = 255;
+        }
+    }
+}
+
+bool BackgroundModel::save(const std::string& path) const
+{
+    if (!learned) {
+        return false;
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    int32_t size[2] = { width, height };
+    bool ok = fwrite(FILE_MAGIC, sizeof(FILE_MAGIC), 1, file) == 1
+        && fwrite(size, sizeof(size), 1, file) == 1
+        && fwrite(background.data(), sizeof(float), background.size(), file) == background.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool BackgroundModel::load(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(FILE_MAGIC)];
+    int32_t size[2];
+    std::vector<float> loaded(width * height);
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1
+        && memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0
+        && fread(size, sizeof(size), 1, file) == 1
+        && size[0] == width && size[1] == height
+        && fread(loaded.data(), sizeof(float), loaded.size(), file) == loaded.size();
+    fclose(file);
+    if (ok) {
+        background.swap(loaded);
+        learned = true;
+    }
+    return ok;
+}
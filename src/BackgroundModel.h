@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-pixel depth background learned over a window of frames, and the
+// foreground against it.
+//
+// While learning every frame is kept (as mm, 2 bytes a pixel) and when the
+// window is full each pixel's background becomes the median of its valid
+// values, or the farthest one in MODE_FARTHEST for scenes where people never
+// leave. Pixels with no valid depth in the window have no background and are
+// never foreground.
+
+class BackgroundModel {
+public:
+    enum Mode {
+        MODE_MEDIAN,
+        MODE_FARTHEST
+    };
+    
+    void setup(int width, int height);
+    
+    void setMode(Mode mode) { this->mode = mode; }
+    Mode getMode() const { return mode; }
+    // mm closer than the background before a pixel counts as foreground
+    void setThreshold(float threshold) { this->threshold = threshold; }
+    float getThreshold() const { return threshold; }
+    
+    // every frame of the window is kept, 130 MB at 512x424
+    static const int MAX_LEARN_FRAMES = 300;
+    
+    // starts a new learning window of 1 to MAX_LEARN_FRAMES frames, the
+    // current background is kept until it ends
+    void learn(int frames);
+    bool isLearning() const { return learnFrames > 0; }
+    bool hasBackground() const { return learned; }
+    // 0..1 through the learning window
+    float getLearningProgress() const;
+    
+    // feeds a frame to the learning window, no-op when not learning
+    void add(const float* depth);
+    
+    // mask is 255 for foreground, rgba carries the foreground depth packed
+    // like the raw depth output (mm = R * 256 + G) with the mask in B.
+    // Either may be null.
+    void foreground(const float* depth, unsigned char* mask, unsigned char* rgba) const;
+    
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+    
+    const float* getBackground() const { return background.data(); }
+    
+private:
+    void finishLearning();
+    
+    int width = 0;
+    int height = 0;
+    Mode mode = MODE_MEDIAN;
+    float threshold = 80.0f;
+    
+    std::vector<float> background;
+    bool learned = false;
+    
+    int learnFrames = 0;
+    int learnedFrames = 0;
+    std::vector<uint16_t> window;
+};
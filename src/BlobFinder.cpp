@@ -0,0 +1,112 @@
+#include "BlobFinder.h"
+
+#include <algorithm>
+
+int BlobFinder::findRoot(int run)
+{
+    while (runs[run].parent != run) {
+        runs[run].parent = runs[runs[run].parent].parent;
+        run = runs[run].parent;
+    }
+    return run;
+}
+
+const std::vector<BlobFinder::Blob>& BlobFinder::find(const unsigned char* mask, const float* depth, int width, int height)
+{
+    runs.clear();
+    blobs.clear();
+    
+    int previousStart = 0;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = mask + y * width;
+        int rowStart = (int)runs.size();
+        int above = previousStart;
+        
+        int x = 0;
+        while (x < width) {
+            while (x < width && !row[x]) {
+                x++;
+            }
+            if (x == width) {
+                break;
+            }
+            int start = x;
+            while (x < width && row[x]) {
+                x++;
+            }
+            int index = (int)runs.size();
+            runs.push_back({ y, start, x, index });
+            
+            // runs in the row above that overlap [start - 1, x], 8-connected
+            while (above < rowStart && runs[above].end < start) {
+                above++;
+            }
+            for (int i = above; i < rowStart && runs[i].start <= x; i++) {
+                int a = findRoot(i);
+                int b = findRoot(index);
+                if (a != b) {
+                    // the older run stays root so roots are found in scan order
+                    runs[std::max(a, b)].parent = std::min(a, b);
+                }
+            }
+        }
+        previousStart = rowStart;
+    }
+    
+    // fold every run into its root
+    accumulators.resize(runs.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Run& run = runs[i];
+        int root = findRoot((int)i);
+        Accumulator& sum = accumulators[root];
+        if (root == (int)i) {
+            sum = { 0, 0, 0, 0, 0, run.start, run.y, run.end - 1, run.y };
+        }
+        int length = run.end - run.start;
+        sum.area += length;
+        sum.sumX += (int64_t)(run.start + run.end - 1) * length / 2;
+        sum.sumY += (int64_t)run.y * length;
+        sum.left = std::min(sum.left, run.start);
+        sum.right = std::max(sum.right, run.end - 1);
+        sum.bottom = std::max(sum.bottom, run.y);
+        if (depth) {
+            const float* values = depth + run.y * width;
+            for (int x = run.start; x < run.end; x++) {
+                if (values[x] > 0) {
+                    sum.sumDepth += values[x];
+                    sum.depthCount++;
+                }
+            }
+        }
+    }
+    
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i].parent != (int)i || accumulators[i].area < minArea) {
+            continue;
+        }
+        const Accumulator& sum = accumulators[i];
+        Blob blob;
+        blob.centroidX = (float)sum.sumX / sum.area;
+        blob.centroidY = (float)sum.sumY / sum.area;
+        blob.left = sum.left;
+        blob.top = sum.top;
+        blob.right = sum.right;
+        blob.bottom = sum.bottom;
+        blob.area = sum.area;
+        blob.meanDepth = sum.depthCount ? (float)(sum.sumDepth / sum.depthCount) : 0.0f;
+        blobs.push_back(blob);
+    }
+    
+    std::sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.area > b.area; });
+    if ((int)blobs.size() > maxBlobs) {
+        blobs.resize(maxBlobs);
+    }
+    return blobs;
+}
+
+void BlobFinder::threshold(const float* depth, float near, float far, unsigned char* mask, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        mask[i] = depth[i] > near && depth[i] < far ? 255 : 0;
+    }
+}
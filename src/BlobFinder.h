@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Connected components of a mask, with the statistics clients want per blob.
+//
+// Each row is cut into runs of set pixels, and a run is joined (union-find
+// with path halving) to every run it touches in the row above, diagonals
+// included. Statistics are summed per run and folded into the root, so the
+// image is read once and the work is proportional to the number of runs
+// rather than pixels. Buffers grow to the largest frame seen and are reused.
+
+class BlobFinder {
+public:
+    struct Blob {
+        // centroid and bounding box in pixels
+        float centroidX;
+        float centroidY;
+        int left;
+        int top;
+        int right;   // inclusive
+        int bottom;
+        int area;
+        // mean of the valid depth under the blob, mm
+        float meanDepth;
+    };
+    
+    void setMinArea(int area) { minArea = area; }
+    void setMaxBlobs(int count) { maxBlobs = count; }
+    
+    // mask is width * height bytes, non zero is set. depth may be null.
+    // Blobs come out largest first.
+    const std::vector<Blob>& find(const unsigned char* mask, const float* depth, int width, int height);
+    const std::vector<Blob>& getBlobs() const { return blobs; }
+    
+    // near < depth < far as a mask, for when there is no foreground
+    static void threshold(const float* depth, float near, float far, unsigned char* mask, size_t count);
+    
+private:
+    struct Run {
+        int y;
+        int start;
+        int end;     // exclusive
+        int parent;
+    };
+    
+    struct Accumulator {
+        int64_t sumX;
+        int64_t sumY;
+        double sumDepth;
+        int depthCount;
+        int area;
+        int left, top, right, bottom;
+    };
+    
+    int findRoot(int run);
+    
+    int minArea = 100;
+    int maxBlobs = 32;
+    
+    std::vector<Run> runs;
+    std::vector<Accumulator> accumulators;
+    std::vector<Blob> blobs;
+};
@@ -0,0 +1,51 @@
+#include "CaptureThread.h"
+
+void CaptureThread::setup(FrameSource& source, FrameStats& stats, bool hasColor, bool hasDepth, bool hasIr)
+{
+    this->source = &source;
+    this->stats = &stats;
+    
+    // allocate every slot up front so the capture loop never touches the heap
+    for (int i = 0; i < TripleBuffer<KinectFrame>::NUM_SLOTS; i++) {
+        KinectFrame& slot = frames.getSlot(i);
+        if (hasColor) {
+            slot.color.allocate(1920 / source.getColorScale(), 1080 / source.getColorScale(), 4);
+        }
+        if (hasDepth || hasIr) {
+            slot.depth.allocate(512, 424, 1);
+            slot.ir.allocate(512, 424, 1);
+        }
+    }
+}
+
+bool CaptureThread::update()
+{
+    return frames.update();
+}
+
+const KinectFrame& CaptureThread::getFrame() const
+{
+    return frames.getReadSlot();
+}
+
+void CaptureThread::threadedFunction()
+{
+    chrono::steady_clock::time_point waitStart = chrono::steady_clock::now();
+    while (isThreadRunning()) {
+        if (!source->waitForFrame()) {
+            continue;
+        }
+        chrono::steady_clock::time_point arrival = chrono::steady_clock::now();
+        stats->get(FrameStats::STAGE_DEVICE_WAIT).record(chrono::duration_cast<chrono::nanoseconds>(arrival - waitStart).count());
+        
+        KinectFrame& slot = frames.getWriteSlot();
+        {
+            ScopedTimer timer(stats->get(FrameStats::STAGE_CAPTURE_COPY));
+            source->readFrame(slot);
+        }
+        slot.sequence = ++sequence;
+        slot.captureTime = chrono::duration_cast<chrono::nanoseconds>(arrival.time_since_epoch()).count();
+        frames.publish();
+        waitStart = chrono::steady_clock::now();
+    }
+}
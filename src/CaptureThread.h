@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ofMain.h"
+#include "TripleBuffer.h"
+#include "FrameStats.h"
+#include "FrameSource.h"
+
+// Pulls frames from a FrameSource on its own thread so a slow packet from the
+// Kinect never stalls the GL loop. update() on the GL thread only swaps an
+// index and then reads the newest complete frame.
+
+class CaptureThread : public ofThread {
+public:
+    void setup(FrameSource& source, FrameStats& stats, bool hasColor, bool hasDepth, bool hasIr);
+    
+    // GL thread: returns true when a newer frame than the last one is available
+    bool update();
+    const KinectFrame& getFrame() const;
+    
+protected:
+    void threadedFunction();
+    
+    FrameSource* source = nullptr;
+    FrameStats* stats = nullptr;
+    TripleBuffer<KinectFrame> frames;
+    uint64_t sequence = 0;
+};
@@ -0,0 +1,171 @@
+#include "ColourScaler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// source rows per band, enough for one row of the smallest level
+static const int BAND_ROWS = 1 << ColourScaler::LEVELS;
+
+int ColourScaler::levelOf(int divisor)
+{
+    switch (divisor) {
+        case 2: return 1;
+        case 4: return 2;
+        case 8: return 3;
+        default: return 0;
+    }
+}
+
+void ColourScaler::setup(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    for (int i = 0; i < LEVELS; i++) {
+        wanted[i] = false;
+        levels[i].clear();
+    }
+    levelCount = 0;
+    setRoi(0, 0, 0, 0);
+}
+
+bool ColourScaler::addScale(int divisor)
+{
+    int level = levelOf(divisor);
+    if (!level) {
+        return false;
+    }
+    wanted[level - 1] = true;
+    levelCount = std::max(levelCount, level);
+    for (int i = 0; i < levelCount; i++) {
+        levels[i].resize((width >> (i + 1)) * (height >> (i + 1)) * 4);
+    }
+    return true;
+}
+
+bool ColourScaler::hasScale(int divisor) const
+{
+    int level = levelOf(divisor);
+    return level && wanted[level - 1];
+}
+
+unsigned char* ColourScaler::getScaled(int divisor)
+{
+    int level = levelOf(divisor);
+    return level ? levels[level - 1].data() : nullptr;
+}
+
+void ColourScaler::setRoi(int x, int y, int width, int height)
+{
+    roiX = std::min(std::max(x, 0), this->width);
+    roiY = std::min(std::max(y, 0), this->height);
+    roiWidth = std::max(std::min(width, this->width - roiX), 0);
+    roiHeight = std::max(std::min(height, this->height - roiY), 0);
+    roi.resize(roiWidth * roiHeight * 4);
+}
+
+void ColourScaler::halve(const unsigned char* row0, const unsigned char* row1, unsigned char* out, int outWidth)
+{
+    int x = 0;
+    // 8 source pixels to 4, channels widened to 16 bits: the two rows are
+    // added, then each pixel's 64 bit half with its neighbour's
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 4 <= outWidth; x += 4) {
+        __m128i result[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8 + half * 16));
+            __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8 + half * 16));
+            __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+            result[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        }
+        _mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(result[0], result[1]));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 4 <= outWidth; x += 4) {
+        uint8x8_t result[2];
+        for (int half = 0; half < 2; half++) {
+            uint8x16_t a = vld1q_u8(row0 + x * 8 + half * 16);
+            uint8x16_t b = vld1q_u8(row1 + x * 8 + half * 16);
+            uint16x8_t low = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+            uint16x8_t high = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+            uint16x8_t sum = vaddq_u16(vcombine_u16(vget_low_u16(low), vget_low_u16(high)),
+                                       vcombine_u16(vget_high_u16(low), vget_high_u16(high)));
+            result[half] = vrshrn_n_u16(sum, 2);
+        }
+        vst1q_u8(out + x * 4, vcombine_u8(result[0], result[1]));
+    }
+#endif
+    for (; x < outWidth; x++) {
+        const unsigned char* a = row0 + x * 8;
+        const unsigned char* b = row1 + x * 8;
+        unsigned char* o = out + x * 4;
+        for (int c = 0; c < 4; c++) {
+            o[c] = (a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2;
+        }
+    }
+}
+
+void ColourScaler::process(const unsigned char* rgba, int divisor, WorkerPool* pool)
+{
+    int start = levelOf(divisor);
+    if (!isActive() || (divisor != 1 && !start)) {
+        return;
+    }
+    bool cropping = hasRoi() && !start;
+    int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    WorkerPool::Task task = [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++) {
+            int y0 = band * BAND_ROWS;
+            int y1 = std::min(y0 + BAND_ROWS, height);
+
+            if (cropping) {
+                int roiTop = std::max(y0, roiY);
+                int roiBottom = std::min(y1, roiY + roiHeight);
+                for (int y = roiTop; y < roiBottom; y++) {
+                    memcpy(&roi[(y - roiY) * roiWidth * 4], rgba + (y * width + roiX) * 4, roiWidth * 4);
+                }
+            }
+
+            // band rows count in full size rows whatever size comes in
+            const unsigned char* above = rgba;
+            int aboveWidth = width >> start;
+            if (start && wanted[start - 1]) {
+                int top = y0 >> start;
+                int bottom = std::min(y1 >> start, height >> start);
+                memcpy(levels[start - 1].data() + (size_t)top * aboveWidth * 4, rgba + (size_t)top * aboveWidth * 4, (size_t)(bottom - top) * aboveWidth * 4);
+            }
+
+            // each level's rows in this band come from the rows of the level
+            // above written just before
+            for (int level = start + 1; level <= levelCount; level++) {
+                int levelWidth = width >> level;
+                int levelHeight = height >> level;
+                unsigned char* out = levels[level - 1].data();
+                int top = y0 >> level;
+                int bottom = std::min(y1 >> level, levelHeight);
+                for (int y = top; y < bottom; y++) {
+                    const unsigned char* row0 = above + (size_t)(2 * y) * aboveWidth * 4;
+                    halve(row0, row0 + aboveWidth * 4, out + (size_t)y * levelWidth * 4, levelWidth);
+                }
+                above = out;
+                aboveWidth = levelWidth;
+            }
+        }
+    };
+    if (pool) {
+        pool->parallelFor(bands, task, 1);
+    }
+    else {
+        task(0, bands);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class WorkerPool;
+
+// Smaller copies of the colour image for consumers that would scale it down
+// anyway: box filtered halves, quarters and eighths, and a full resolution
+// crop of a region of interest.
+//
+// Each level is the 2x2 average of the level above, worked out in bands of
+// 8 source rows so the rows a level reads were written moments before and
+// are still in cache. The source is read once per frame whichever sizes are
+// wanted; a level that is not wanted but sits between the source and one
+// that is gets computed into an internal buffer. A source that already
+// delivers colour at one of the sizes (see FrameSource::setColorScale)
+// starts the chain there. Pixels are 4 bytes, each channel averaged on its
+// own, so RGBA and BGRA both work.
+
+class ColourScaler {
+public:
+    static const int LEVELS = 3;
+
+    void setup(int width, int height);
+
+    // divisor 2, 4 or 8, returns false for anything else
+    bool addScale(int divisor);
+    bool hasScale(int divisor) const;
+    // clipped to the image, an empty region turns the crop off
+    void setRoi(int x, int y, int width, int height);
+    bool hasRoi() const { return roiWidth > 0 && roiHeight > 0; }
+    bool isActive() const { return levelCount > 0 || hasRoi(); }
+
+    int getScaledWidth(int divisor) const { return width / divisor; }
+    int getScaledHeight(int divisor) const { return height / divisor; }
+    unsigned char* getScaled(int divisor);
+    int getRoiX() const { return roiX; }
+    int getRoiY() const { return roiY; }
+    int getRoiWidth() const { return roiWidth; }
+    int getRoiHeight() const { return roiHeight; }
+    unsigned char* getRoi() { return roi.data(); }
+
+    // rgba is the image at 1/divisor of full size, which is then copied to
+    // its own level if wanted. Smaller levels are made from it, the crop
+    // needs divisor 1. pool may be null
+    void process(const unsigned char* rgba, int divisor, WorkerPool* pool);
+
+    // one level from the one above, 2x2 box average with rounding
+    static void halve(const unsigned char* row0, const unsigned char* row1, unsigned char* out, int outWidth);
+
+private:
+    static int levelOf(int divisor);
+
+    int width = 0;
+    int height = 0;
+    bool wanted[LEVELS] = {};
+    // deepest level computed, 0 for none
+    int levelCount = 0;
+    std::vector<unsigned char> levels[LEVELS];
+
+    int roiX = 0;
+    int roiY = 0;
+    int roiWidth = 0;
+    int roiHeight = 0;
+    std::vector<unsigned char> roi;
+};
@@ -0,0 +1,189 @@
+#include "DepthCodec.h"
+
+#include <cstring>
+
+namespace {
+
+    // codes of the values below 2^12, up to four nibbles, which is nearly
+    // every run length and difference: code in the low 16 bits, nibble count
+    // above
+    const int TABLE_BITS = 12;
+
+    struct CodeTable {
+        uint32_t codes[1 << TABLE_BITS];
+
+        CodeTable() {
+            for (uint32_t value = 0; value < (1 << TABLE_BITS); value++) {
+                uint32_t code = 0;
+                uint32_t nibbles = 0;
+                uint32_t rest = value;
+                do {
+                    uint32_t nibble = rest & 0x7;
+                    rest >>= 3;
+                    if (rest) {
+                        nibble |= 0x8;
+                    }
+                    code = (code << 4) | nibble;
+                    nibbles++;
+                } while (rest);
+                codes[value] = code | (nibbles << 16);
+            }
+        }
+    };
+
+    const CodeTable codeTable;
+
+    // the longest run the decoder takes, seven nibbles. Longer runs are
+    // split with an empty run of the other kind in between
+    const uint32_t MAX_RUN = (1 << 21) - 1;
+
+    // codes are collected in a 64 bit accumulator and stored a word at a time
+    struct NibbleWriter {
+        unsigned char* out;
+        uint64_t bits = 0;
+        int count = 0;
+
+        explicit NibbleWriter(unsigned char* out) : out(out) {}
+
+        inline void put(uint32_t value) {
+            if (value < (1 << TABLE_BITS)) {
+                uint32_t code = codeTable.codes[value];
+                int length = (code >> 16) * 4;
+                bits = (bits << length) | (code & 0xffff);
+                count += length;
+            }
+            else {
+                do {
+                    uint32_t nibble = value & 0x7;
+                    value >>= 3;
+                    if (value) {
+                        nibble |= 0x8;
+                    }
+                    bits = (bits << 4) | nibble;
+                    count += 4;
+                } while (value);
+            }
+            // at most 28 bits left over plus 28 for the longest code, a run
+            // of up to 2^21 pixels
+            if (count >= 32) {
+                count -= 32;
+                store(bits >> count);
+            }
+        }
+
+        // pads the last word with zero nibbles
+        inline void finish() {
+            if (count) {
+                store(bits << (32 - count));
+                count = 0;
+            }
+        }
+
+        inline void store(uint32_t word) {
+            out[0] = word;
+            out[1] = word >> 8;
+            out[2] = word >> 16;
+            out[3] = word >> 24;
+            out += 4;
+        }
+    };
+
+    struct NibbleReader {
+        const unsigned char* in;
+        const unsigned char* end;
+        uint32_t word = 0;
+        int nibbles = 0;
+
+        NibbleReader(const unsigned char* in, size_t size) : in(in), end(in + (size & ~(size_t)3)) {}
+
+        // false when the data runs out or a code is longer than any the
+        // encoder writes, seven nibbles for a run up to MAX_RUN
+        inline bool get(uint32_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 21; shift += 3) {
+                if (!nibbles) {
+                    if (in == end) {
+                        return false;
+                    }
+                    word = in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+                    in += 4;
+                    nibbles = 8;
+                }
+                uint32_t nibble = word >> 28;
+                word <<= 4;
+                nibbles--;
+                value |= (nibble & 0x7) << shift;
+                if (!(nibble & 0x8)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+}
+
+size_t DepthCodec::getMaxEncodedSize(size_t count)
+{
+    // at worst every pixel is valid and differs from the last by more than
+    // 2^14, six nibbles each, after two run lengths of up to seven nibbles
+    size_t nibbles = count * 6 + 2 * 7;
+    return (nibbles + 7) / 8 * 4;
+}
+
+size_t DepthCodec::encode(const uint16_t* depth, size_t count, unsigned char* encoded)
+{
+    NibbleWriter writer(encoded);
+    const uint16_t* end = depth + count;
+    int previous = 0;
+    while (depth != end) {
+        const uint16_t* start = depth;
+        while (depth != end && !*depth && (uint32_t)(depth - start) < MAX_RUN) {
+            depth++;
+        }
+        writer.put(depth - start);
+
+        start = depth;
+        while (depth != end && *depth && (uint32_t)(depth - start) < MAX_RUN) {
+            depth++;
+        }
+        writer.put(depth - start);
+        for (const uint16_t* pixel = start; pixel != depth; pixel++) {
+            int delta = *pixel - previous;
+            writer.put(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            previous = *pixel;
+        }
+    }
+    writer.finish();
+    return writer.out - encoded;
+}
+
+bool DepthCodec::decode(const unsigned char* encoded, size_t size, uint16_t* depth, size_t count)
+{
+    NibbleReader reader(encoded, size);
+    uint16_t* end = depth + count;
+    // wraps like the 16 bit pixels, so hostile deltas can't overflow it
+    uint16_t previous = 0;
+    while (depth != end) {
+        uint32_t zeros, valid;
+        if (!reader.get(zeros) || zeros > (size_t)(end - depth)) {
+            return false;
+        }
+        memset(depth, 0, zeros * sizeof(uint16_t));
+        depth += zeros;
+
+        if (!reader.get(valid) || valid > (size_t)(end - depth)) {
+            return false;
+        }
+        for (uint16_t* last = depth + valid; depth != last; depth++) {
+            // a zigzagged difference of two 16 bit values fits in 17 bits
+            uint32_t code;
+            if (!reader.get(code) || code >> 17) {
+                return false;
+            }
+            previous = (uint16_t)(previous + ((code >> 1) ^ (0u - (code & 1))));
+            *depth = previous;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Lossless compression of 16 bit depth images, mm with 0 for no depth.
+//
+// RVL (A. Wilson, "Fast Lossless Depth Image Compression", 2017): the image
+// is a sequence of runs, a run of zeros then a run of valid pixels, the
+// valid pixels stored as the zigzagged difference to the previous valid
+// pixel. Every number is a variable length code of 3 bit groups, one nibble
+// each with the top bit set when more follow, and the nibbles are packed
+// eight to a 32 bit word, first nibble in the top bits. Words are little
+// endian on the wire.
+//
+// Kinect depth is mostly smooth surfaces and zero holes, so most pixels
+// take one or two nibbles: a 512x424 frame comes out 3 to 4 times smaller
+// than its 16 bit pixels, less in noisy scenes, and takes around a
+// millisecond to encode or decode on one core. DepthCodec.cpp needs nothing
+// else, receivers can build it on its own. The decoder checks every count
+// against the buffers, so it can be given data straight from the network.
+
+namespace DepthCodec {
+
+    // the most bytes encoding count pixels can take
+    size_t getMaxEncodedSize(size_t count);
+    
+    // returns the bytes written to encoded, which holds getMaxEncodedSize(count)
+    size_t encode(const uint16_t* depth, size_t count, unsigned char* encoded);
+    
+    // false if encoded is not count pixels of RVL data
+    bool decode(const unsigned char* encoded, size_t size, uint16_t* depth, size_t count);
+
+}
@@ -0,0 +1,228 @@
+#include "DepthFusion.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+// depth rows per block and map rows per band, small enough to spread a few
+// sensors over many threads and large enough to keep the counts small
+static const int BLOCK_ROWS = 16;
+static const int TILE_ROWS = 16;
+static const uint32_t NO_CELL = UINT32_MAX;
+
+namespace {
+
+    void forEach(WorkerPool* pool, size_t count, const WorkerPool::Task& task)
+    {
+        if (pool) {
+            pool->parallelFor(count, task, 1);
+        }
+        else {
+            task(0, count);
+        }
+    }
+
+    // a = a * b for row major 3x3 matrices
+    void multiply(float* a, const float* b)
+    {
+        float result[9];
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++) {
+                result[row * 3 + column] = a[row * 3] * b[column] + a[row * 3 + 1] * b[3 + column] + a[row * 3 + 2] * b[6 + column];
+            }
+        }
+        std::copy(result, result + 9, a);
+    }
+
+}
+
+void DepthFusion::setup(int sensorCount, int width, int height, const Area& area)
+{
+    this->sensorCount = sensorCount;
+    this->width = width;
+    this->height = height;
+    this->area = area;
+    blocksPerSensor = (height + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    mapWidth = std::max(1, (int)std::ceil((area.maxX - area.minX) / area.cellSize));
+    mapHeight = std::max(1, (int)std::ceil((area.maxY - area.minY) / area.cellSize));
+    tileCount = (mapHeight + TILE_ROWS - 1) / TILE_ROWS;
+
+    size_t pixels = (size_t)width * height;
+    rays.assign(sensorCount, std::vector<float>());
+    positions.assign(sensorCount * 3, 0.0f);
+    pending.assign(sensorCount, nullptr);
+    flipped.assign(sensorCount, 0);
+    points.assign(sensorCount * pixels * 3, 0.0f);
+    cells.assign(sensorCount * pixels, NO_CELL);
+    counts.assign(sensorCount * blocksPerSensor * tileCount, 0);
+    offsets.assign(counts.size(), 0);
+    tileStarts.assign(tileCount + 1, 0);
+    entries.resize(sensorCount * pixels);
+    heightMap.assign((size_t)mapWidth * mapHeight, 0.0f);
+}
+
+void DepthFusion::setSensor(int sensor, const PointCloud::Intrinsics& intrinsics, const Pose& pose)
+{
+    const float toRadians = 3.14159265f / 180.0f;
+    float cy = std::cos(pose.yaw * toRadians), sy = std::sin(pose.yaw * toRadians);
+    float cp = std::cos(pose.pitch * toRadians), sp = std::sin(pose.pitch * toRadians);
+    float cr = std::cos(pose.roll * toRadians), sr = std::sin(pose.roll * toRadians);
+    // camera to world: yaw about z, pitch about x, the level camera's axes
+    // (x right, y up, z forward) as world x, z and y, then roll about the
+    // camera's own z
+    float rotation[9] = { cy, -sy, 0, sy, cy, 0, 0, 0, 1 };
+    const float pitch[9] = { 1, 0, 0, 0, cp, -sp, 0, sp, cp };
+    const float level[9] = { 1, 0, 0, 0, 0, 1, 0, 1, 0 };
+    const float roll[9] = { cr, -sr, 0, sr, cr, 0, 0, 0, 1 };
+    multiply(rotation, pitch);
+    multiply(rotation, level);
+    multiply(rotation, roll);
+
+    PointCloud camera;
+    camera.setup(width, height, intrinsics);
+    std::vector<float>& world = rays[sensor];
+    world.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float ray[3];
+            camera.getRay(x, y, ray[0], ray[1]);
+            ray[2] = 0.001f;
+            float* out = &world[((size_t)y * width + x) * 3];
+            for (int i = 0; i < 3; i++) {
+                out[i] = rotation[i * 3] * ray[0] + rotation[i * 3 + 1] * ray[1] + rotation[i * 3 + 2] * ray[2];
+            }
+        }
+    }
+    positions[sensor * 3] = pose.x;
+    positions[sensor * 3 + 1] = pose.y;
+    positions[sensor * 3 + 2] = pose.z;
+}
+
+void DepthFusion::setDepth(int sensor, const float* depth, bool flipped)
+{
+    pending[sensor] = depth;
+    this->flipped[sensor] = flipped;
+}
+
+void DepthFusion::process(WorkerPool* pool, bool heightMap)
+{
+    std::vector<int> blocks;
+    for (int sensor = 0; sensor < sensorCount; sensor++) {
+        if (pending[sensor] && !rays[sensor].empty()) {
+            for (int i = 0; i < blocksPerSensor; i++) {
+                blocks.push_back(sensor * blocksPerSensor + i);
+            }
+        }
+    }
+    forEach(pool, blocks.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            transform(blocks[i]);
+        }
+    });
+    std::fill(pending.begin(), pending.end(), nullptr);
+    if (!heightMap) {
+        return;
+    }
+
+    // each map band's entries start after the previous band's, and within
+    // a band each block's after the previous block's
+    int blockCount = sensorCount * blocksPerSensor;
+    size_t total = 0;
+    for (int tile = 0; tile < tileCount; tile++) {
+        tileStarts[tile] = total;
+        for (int block = 0; block < blockCount; block++) {
+            offsets[block * tileCount + tile] = total;
+            total += counts[block * tileCount + tile];
+        }
+    }
+    tileStarts[tileCount] = total;
+
+    forEach(pool, blockCount, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; block++) {
+            scatter(block);
+        }
+    });
+    forEach(pool, tileCount, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++) {
+            reduce(tile);
+        }
+    });
+}
+
+void DepthFusion::transform(int block)
+{
+    int sensor = block / blocksPerSensor;
+    int y0 = (block % blocksPerSensor) * BLOCK_ROWS;
+    int y1 = std::min(y0 + BLOCK_ROWS, height);
+    const float* depth = pending[sensor];
+    const float* ray = rays[sensor].data();
+    const float* position = &positions[sensor * 3];
+    bool mirrored = flipped[sensor];
+    size_t first = (size_t)sensor * width * height;
+    uint32_t* blockCounts = &counts[block * tileCount];
+    std::fill(blockCounts, blockCounts + tileCount, 0);
+
+    float scale = 1.0f / area.cellSize;
+    float minHeight = area.minHeight * 1000.0f;
+    float maxHeight = area.maxHeight * 1000.0f;
+    for (int y = y0; y < y1; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t i = (size_t)y * width + x;
+            // a mirrored image has the rays of the other side
+            const float* r = &ray[(mirrored ? (size_t)y * width + width - 1 - x : i) * 3];
+            float* point = &points[(first + i) * 3];
+            uint32_t& cell = cells[first + i];
+            float d = depth[i];
+            if (d <= 0) {
+                point[0] = point[1] = point[2] = 0.0f;
+                cell = NO_CELL;
+                continue;
+            }
+            point[0] = r[0] * d + position[0];
+            point[1] = r[1] * d + position[1];
+            point[2] = r[2] * d + position[2];
+
+            float column = (point[0] - area.minX) * scale;
+            float row = (area.maxY - point[1]) * scale;
+            float mm = point[2] * 1000.0f;
+            if (column >= 0 && row >= 0 && column < mapWidth && row < mapHeight && mm >= minHeight && mm <= maxHeight) {
+                int mapRow = (int)row;
+                cell = mapRow * mapWidth + (int)column;
+                blockCounts[mapRow / TILE_ROWS]++;
+            }
+            else {
+                cell = NO_CELL;
+            }
+        }
+    }
+}
+
+void DepthFusion::scatter(int block)
+{
+    int sensor = block / blocksPerSensor;
+    int y0 = (block % blocksPerSensor) * BLOCK_ROWS;
+    int y1 = std::min(y0 + BLOCK_ROWS, height);
+    size_t first = (size_t)sensor * width * height;
+    size_t* next = &offsets[block * tileCount];
+    uint32_t bandCells = TILE_ROWS * mapWidth;
+    for (size_t i = first + (size_t)y0 * width; i < first + (size_t)y1 * width; i++) {
+        uint32_t cell = cells[i];
+        if (cell != NO_CELL) {
+            Entry& entry = entries[next[cell / bandCells]++];
+            entry.cell = cell;
+            entry.height = points[i * 3 + 2] * 1000.0f;
+        }
+    }
+}
+
+void DepthFusion::reduce(int tile)
+{
+    int row0 = tile * TILE_ROWS;
+    int row1 = std::min(row0 + TILE_ROWS, mapHeight);
+    float* map = heightMap.data();
+    std::fill(map + (size_t)row0 * mapWidth, map + (size_t)row1 * mapWidth, 0.0f);
+    for (size_t i = tileStarts[tile]; i < tileStarts[tile + 1]; i++) {
+        const Entry& entry = entries[i];
+        map[entry.cell] = std::max(map[entry.cell], entry.height);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+
+class WorkerPool;
+
+// Several sensors' depth merged in one world space, as a point cloud and as a
+// top-down height map of the floor they cover.
+//
+// World space is in metres with x and y along the floor and z up. Each
+// sensor's pose places it there; its per-pixel rays are rotated into world
+// space once in setSensor(), so a point costs three multiply-adds like
+// PointCloud::unproject(). The merged cloud is every sensor's points one
+// after the other, 0, 0, 0 where a sensor has no depth.
+//
+// The height map is a grid over the floor area holding, per cell, the height
+// in mm of the highest point above it, 0 where there is none within the
+// height range. Row 0 is the far (maxY) edge, so it reads like a plan.
+// Sensors overlap anywhere on the floor, so rather than have threads race
+// for cells the points are sorted into bands of map rows first: each band of
+// depth rows counts its points per map band, the counts give every depth
+// band a private range of each map band to write to, and then every map
+// band takes the highest point per cell on its own. All three passes run
+// over the worker pool, the work split per sensor and per band.
+
+class DepthFusion {
+public:
+    // where a sensor is and which way it looks. With no rotation it looks
+    // along +y, level, image upright. Yaw then turns it left about z, pitch
+    // tilts it up (-90 looks straight down) and roll turns it
+    // anticlockwise as seen from behind. Metres and degrees
+    struct Pose {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float yaw = 0.0f;
+        float pitch = 0.0f;
+        float roll = 0.0f;
+    };
+    
+    // the floor rectangle the height map covers and its cell size, and the
+    // heights a point must be between to count, metres
+    struct Area {
+        float minX = -2.0f;
+        float minY = -2.0f;
+        float maxX = 2.0f;
+        float maxY = 2.0f;
+        float cellSize = 0.02f;
+        float minHeight = 0.05f;
+        float maxHeight = 2.5f;
+    };
+    
+    // width and height are the depth image's
+    void setup(int sensorCount, int width, int height, const Area& area);
+    void setSensor(int sensor, const PointCloud::Intrinsics& intrinsics, const Pose& pose);
+    
+    // a sensor's newest depth in mm, flipped when the image is mirrored. It
+    // must stay valid until process()
+    void setDepth(int sensor, const float* depth, bool flipped);
+    // moves the depth given since the last call into world space and, with
+    // heightMap, rebuilds the map from every sensor's latest points. pool
+    // may be null to run on the calling thread
+    void process(WorkerPool* pool, bool heightMap);
+    
+    int getSensorCount() const { return sensorCount; }
+    // 3 floats per point, sensor after sensor
+    const float* getPoints() const { return points.data(); }
+    size_t getPointCount() const { return points.size() / 3; }
+    
+    const float* getHeightMap() const { return heightMap.data(); }
+    int getMapWidth() const { return mapWidth; }
+    int getMapHeight() const { return mapHeight; }
+    const Area& getArea() const { return area; }
+
+private:
+    struct Entry {
+        uint32_t cell;
+        float height;
+    };
+    
+    // world space points and cells of the depth rows in one block
+    void transform(int block);
+    // sorts a block's points into its ranges of entries
+    void scatter(int block);
+    // the highest point per cell in one band of map rows
+    void reduce(int tile);
+    
+    int sensorCount = 0;
+    int width = 0;
+    int height = 0;
+    int blocksPerSensor = 0;
+    int mapWidth = 0;
+    int mapHeight = 0;
+    int tileCount = 0;
+    Area area;
+    
+    // per sensor: the pixels' world space rays scaled to metres per mm,
+    // interleaved x y z, and the sensor position
+    std::vector<std::vector<float>> rays;
+    std::vector<float> positions;
+    std::vector<const float*> pending;
+    std::vector<unsigned char> flipped;
+    
+    std::vector<float> points;
+    // map cell of every point, NO_CELL when it is off the map
+    std::vector<uint32_t> cells;
+    // points per block and map band, then where the block writes in entries
+    std::vector<uint32_t> counts;
+    std::vector<size_t> offsets;
+    std::vector<size_t> tileStarts;
+    std::vector<Entry> entries;
+    std::vector<float> heightMap;
+};
@@ -0,0 +1,150 @@
+#include "DepthMapping.h"
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+// mm, the closest near and the least far can be beyond it. The bound comes
+// first in the std::max calls below so a NaN gives the bound
+static const float MIN_NEAR = 1.0f;
+
+DepthMapping::DepthMapping()
+: near(500)
+, far(5000)
+, invert(true)
+, curve(CURVE_LINEAR)
+, dirty(true)
+// the byte table has 3 bytes of padding so 32 bit gathers never read past it
+, unitTable(TABLE_SIZE)
+, greyTable(TABLE_SIZE + 3)
+{
+}
+
+void DepthMapping::setNear(float near)
+{
+    near = std::min(far - MIN_NEAR, std::max(MIN_NEAR, near));
+    dirty = dirty || near != this->near;
+    this->near = near;
+}
+
+void DepthMapping::setFar(float far)
+{
+    far = std::max(near + MIN_NEAR, far);
+    dirty = dirty || far != this->far;
+    this->far = far;
+}
+
+void DepthMapping::setRange(float near, float far)
+{
+    near = std::max(MIN_NEAR, near);
+    far = std::max(near + MIN_NEAR, far);
+    dirty = dirty || near != this->near || far != this->far;
+    this->near = near;
+    this->far = far;
+}
+
+void DepthMapping::setInvert(bool invert)
+{
+    dirty = dirty || invert != this->invert;
+    this->invert = invert;
+}
+
+void DepthMapping::setCurve(Curve curve)
+{
+    dirty = dirty || curve != this->curve;
+    this->curve = curve;
+}
+
+bool DepthMapping::loadCurveFile(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+    std::vector<float> points;
+    float point;
+    while (file >> point) {
+        points.push_back(point);
+    }
+    if (points.size() < 2) {
+        return false;
+    }
+    curvePoints.swap(points);
+    curve = CURVE_LUT;
+    dirty = true;
+    return true;
+}
+
+std::string DepthMapping::getCurveName(Curve curve)
+{
+    switch (curve) {
+        case CURVE_LOG: return "log";
+        case CURVE_INVERSE: return "inverse";
+        case CURVE_LUT: return "lut";
+        default: return "linear";
+    }
+}
+
+bool DepthMapping::parseCurve(const std::string& name, Curve& curve)
+{
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    for (int i = 0; i < CURVE_COUNT; i++) {
+        if (lower == getCurveName((Curve)i)) {
+            curve = (Curve)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// position between near and far, 0..1 before inversion
+float DepthMapping::mapCurve(float millimetres) const
+{
+    switch (curve) {
+        case CURVE_LOG:
+            return std::log(millimetres / near) / std::log(far / near);
+        case CURVE_INVERSE:
+            return (1.0f / near - 1.0f / millimetres) / (1.0f / near - 1.0f / far);
+        case CURVE_LUT: {
+            if (curvePoints.size() < 2) {
+                break;
+            }
+            float position = (millimetres - near) / (far - near) * (curvePoints.size() - 1);
+            size_t index = std::min((size_t)position, curvePoints.size() - 2);
+            float fraction = position - index;
+            return curvePoints[index] + (curvePoints[index + 1] - curvePoints[index]) * fraction;
+        }
+        default:
+            break;
+    }
+    return (millimetres - near) / (far - near);
+}
+
+bool DepthMapping::update()
+{
+    if (!dirty) {
+        return false;
+    }
+    
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        float millimetres = (float)i;
+        float unit = 0;
+        if (millimetres > near && millimetres < far) {
+            // 1 - t is exactly what the original shader's inverted remap rounds to
+            float t = std::min(std::max(mapCurve(millimetres), 0.0f), 1.0f);
+            unit = invert ? 1.0f - t : t;
+        }
+        unitTable[i] = unit;
+        greyTable[i] = (unsigned char)lrintf(unit * 255.0f);
+    }
+    
+    dirty = false;
+    return true;
+}
+
+void DepthMapping::toGrey(const float* depth, unsigned char* grey, size_t count) const
+{
+    PixelKernels::lookupGrey(depth, greyTable.data(), grey, count);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Maps Kinect depth in millimetres to the 0..1 grey value that gets published.
+// Near/far clip, inversion and the curve are folded into one table indexed by
+// the integer millimetre value, so converting a pixel is one table fetch on
+// the CPU or one texture fetch in the depth shader. Depth outside near..far
+// (and the device's 0 for "no data") maps to 0.
+//
+// The default, linear 500..5000 inverted, reproduces the original hard-coded
+// depth shader bit for bit at whole millimetres, which is all the device
+// delivers; --selftest checks the table against it.
+
+class DepthMapping {
+public:
+    enum Curve {
+        CURVE_LINEAR,
+        CURVE_LOG,      // equal steps per ratio of distance
+        CURVE_INVERSE,  // linear in 1/depth, more resolution up close
+        CURVE_LUT,      // control points loaded from a file
+        CURVE_COUNT
+    };
+    
+    static const int TABLE_SIZE = 65536;
+    
+    DepthMapping();
+    
+    // near is at least 1 mm and far at least 1 mm beyond near, the curves
+    // divide by both. Each setter clamps against the other's current value,
+    // setRange() sets both at once
+    void setNear(float near);
+    void setFar(float far);
+    void setRange(float near, float far);
+    void setInvert(bool invert);
+    void setCurve(Curve curve);
+    // whitespace separated 0..1 values spread evenly from near to far,
+    // replaces the control points and switches to CURVE_LUT
+    bool loadCurveFile(const std::string& path);
+    // CURVE_LUT without control points maps like CURVE_LINEAR
+    bool hasCurvePoints() const { return curvePoints.size() >= 2; }
+    
+    float getNear() const { return near; }
+    float getFar() const { return far; }
+    bool getInvert() const { return invert; }
+    Curve getCurve() const { return curve; }
+    
+    static std::string getCurveName(Curve curve);
+    static bool parseCurve(const std::string& name, Curve& curve);
+    
+    // rebuilds the tables if a setting changed since the last call,
+    // returns true when it did
+    bool update();
+    
+    const float* getUnitTable() const { return unitTable.data(); }
+    const unsigned char* getGreyTable() const { return greyTable.data(); }
+    
+    void toGrey(const float* depth, unsigned char* grey, size_t count) const;
+    
+private:
+    float mapCurve(float millimetres) const;
+    
+    float near;
+    float far;
+    bool invert;
+    Curve curve;
+    std::vector<float> curvePoints;
+    
+    bool dirty;
+    std::vector<float> unitTable;
+    std::vector<unsigned char> greyTable;
+};
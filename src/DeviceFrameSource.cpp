@@ -0,0 +1,88 @@
+#include "DeviceFrameSource.h"
+#include "libfreenect2/libfreenect2.hpp"
+
+DeviceFrameSource::DeviceFrameSource(int deviceIndex, int openCLDevice)
+: deviceIndex(deviceIndex)
+, openCLDevice(openCLDevice)
+{
+}
+
+// ofxMultiKinectV2 opens devices by index, which follows the USB
+// enumeration order, so serials are looked up in a context of our own
+int DeviceFrameSource::findDevice(const string& serial)
+{
+    libfreenect2::Freenect2 context;
+    int count = context.enumerateDevices();
+    for (int i = 0; i < count; i++) {
+        if (context.getDeviceSerialNumber(i) == serial) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool DeviceFrameSource::open(bool hasColor, bool hasDepth, bool hasIr)
+{
+    this->hasColor = hasColor;
+    this->hasDepth = hasDepth;
+    this->hasIr = hasIr;
+    
+    // depth and IR come as a pair from the device. Fails when there is no
+    // Kinect at deviceIndex
+    if (!kinect.open(hasColor, hasDepth || hasIr, deviceIndex, openCLDevice)) {
+        return false;
+    }
+    
+    // Note :
+    // Default OpenCL device might not be optimal.
+    // e.g. Intel HD Graphics will be chosen instead of GeForce.
+    // To avoid it, specify OpenCL device index manually like following.
+    // kinect1.open(true, true, 0, 2); // GeForce on MacBookPro Retina
+    
+    kinect.start();
+    return true;
+}
+
+void DeviceFrameSource::close()
+{
+    kinect.close();
+}
+
+bool DeviceFrameSource::waitForFrame()
+{
+    kinect.update();
+    if (!kinect.isFrameNew()) {
+        ofSleepMillis(1);
+        return false;
+    }
+    return true;
+}
+
+void DeviceFrameSource::readFrame(KinectFrame& frame)
+{
+    if (hasColor) {
+        frame.color = kinect.getColorPixelsRef();
+    }
+    if (hasDepth) {
+        frame.depth = kinect.getDepthPixelsRef();
+    }
+    if (hasIr) {
+        frame.ir = kinect.getIrPixelsRef();
+    }
+}
+
+string DeviceFrameSource::getName() const
+{
+    return "Kinect " + ofToString(deviceIndex);
+}
+
+void DeviceFrameSource::setFlip(bool flip)
+{
+    this->flip = flip;
+    kinect.setEnableFlipBuffer(flip);
+}
+
+bool DeviceFrameSource::getFlip() const
+{
+    return flip;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "ofxMultiKinectV2.h"
+
+class DeviceFrameSource : public FrameSource {
+public:
+    DeviceFrameSource(int deviceIndex, int openCLDevice);
+    
+    // index of the connected Kinect with this serial number, -1 if none is
+    static int findDevice(const string& serial);
+    
+    bool open(bool hasColor, bool hasDepth, bool hasIr);
+    void close();
+    
+    bool waitForFrame();
+    void readFrame(KinectFrame& frame);
+    
+    string getName() const;
+    
+    void setFlip(bool flip);
+    bool getFlip() const;
+    
+private:
+    ofxMultiKinectV2 kinect;
+    int deviceIndex;
+    int openCLDevice;
+    bool hasColor = false;
+    bool hasDepth = false;
+    bool hasIr = false;
+    bool flip = false;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ofMain.h"
+
+struct KinectFrame {
+    ofPixels color;
+    ofFloatPixels depth;
+    ofFloatPixels ir;
+    
+    // ofxMultiKinectV2 does not pass the device timestamps through, so frames
+    // are numbered and stamped (steady clock, ns) as soon as they arrive
+    uint64_t sequence = 0;
+    uint64_t captureTime = 0;
+};
+
+// Where CaptureThread gets its frames from: the Kinect, a recording or a
+// synthetic scene. Chosen with SOURCE in settings.xml so everything after
+// capture can run and be tested without a sensor.
+//
+// Both calls happen on the capture thread. waitForFrame() blocks until a
+// frame is available (or briefly, returning false, so the thread can check
+// whether it should stop) and readFrame() then fills the preallocated
+// 1920x1080 RGBA colour and 512x424 depth/IR planes of a frame. The colour
+// plane is smaller when the source was asked for a colour scale.
+
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+    
+    virtual bool open(bool hasColor, bool hasDepth, bool hasIr) = 0;
+    virtual void close() = 0;
+    
+    virtual bool waitForFrame() = 0;
+    virtual void readFrame(KinectFrame& frame) = 0;
+    
+    virtual string getName() const = 0;
+    
+    // only the device can flip its buffers
+    virtual void setFlip(bool flip) {}
+    virtual bool getFlip() const { return false; }
+    
+    // colour at 1/divisor of full size, for sources that can produce it for
+    // less than a full frame costs. Called before open(), returns false if
+    // the source can't, colour then stays full size
+    virtual bool setColorScale(int divisor) { return divisor == 1; }
+    virtual int getColorScale() const { return 1; }
+};
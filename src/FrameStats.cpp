@@ -0,0 +1,87 @@
+#include "FrameStats.h"
+
+string FrameStats::getStageName(Stage stage)
+{
+    switch (stage) {
+        case STAGE_DEVICE_WAIT: return "device/wait";
+        case STAGE_CAPTURE_COPY: return "device/copy";
+        case STAGE_FILTER_SPATIAL: return "filter/spatial";
+        case STAGE_FILTER_TEMPORAL: return "filter/temporal";
+        case STAGE_CONVERT_DEPTH: return "convert/depth";
+        case STAGE_CONVERT_IR: return "convert/ir";
+        case STAGE_CONVERT_RAW_DEPTH: return "convert/rawdepth";
+        case STAGE_CONVERT_FOREGROUND: return "convert/foreground";
+        case STAGE_BLOBS: return "blobs";
+        case STAGE_CONVERT_POINTS: return "convert/points";
+        case STAGE_REGISTER_COLOUR: return "register/colour";
+        case STAGE_REGISTER_DEPTH: return "register/depth";
+        case STAGE_SCALE_COLOUR: return "convert/colourscaled";
+        case STAGE_FUSION: return "fusion";
+        case STAGE_UPLOAD_COLOUR: return "upload/colour";
+        case STAGE_UPLOAD_DEPTH: return "upload/depth";
+        case STAGE_UPLOAD_IR: return "upload/ir";
+        case STAGE_UPLOAD_RAW_DEPTH: return "upload/rawdepth";
+        case STAGE_UPLOAD_FOREGROUND: return "upload/foreground";
+        case STAGE_UPLOAD_POINTS: return "upload/points";
+        case STAGE_UPLOAD_REGISTERED_COLOUR: return "upload/registeredcolour";
+        case STAGE_UPLOAD_COLOUR_DEPTH: return "upload/colourdepth";
+        case STAGE_UPLOAD_SCALED_COLOUR: return "upload/colourscaled";
+        case STAGE_UPLOAD_FUSION: return "upload/fusion";
+        case STAGE_SHADER_DEPTH: return "shader/depth";
+        case STAGE_SHADER_IR: return "shader/ir";
+        case STAGE_PUBLISH_COLOUR: return "publish/colour";
+        case STAGE_PUBLISH_DEPTH: return "publish/depth";
+        case STAGE_PUBLISH_IR: return "publish/ir";
+        case STAGE_PUBLISH_RAW_DEPTH: return "publish/rawdepth";
+        case STAGE_PUBLISH_FOREGROUND: return "publish/foreground";
+        case STAGE_PUBLISH_POINTS: return "publish/points";
+        case STAGE_PUBLISH_REGISTERED_COLOUR: return "publish/registeredcolour";
+        case STAGE_PUBLISH_COLOUR_DEPTH: return "publish/colourdepth";
+        case STAGE_PUBLISH_SCALED_COLOUR: return "publish/colourscaled";
+        case STAGE_PUBLISH_FUSION: return "publish/fusion";
+        case STAGE_PUBLISH_TRANSPORTS: return "publish/transports";
+        case STAGE_OSC: return "osc";
+        case STAGE_CAPTURE_TO_PUBLISH: return "latency/publish";
+        default: return "unknown";
+    }
+}
+
+void FrameStats::setup(float interval)
+{
+    this->interval = interval;
+    lastSendTime = ofGetElapsedTimef();
+}
+
+void FrameStats::update(ofxOscSender& sender)
+{
+    if (interval <= 0 || ofGetElapsedTimef() - lastSendTime < interval) {
+        return;
+    }
+    lastSendTime = ofGetElapsedTimef();
+    
+    // stages that did not run this interval are left out of the bundle
+    ofxOscBundle bundle;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        LatencyHistogram::Summary summary = stages[i].snapshot();
+        if (!summary.count) {
+            continue;
+        }
+        ofxOscMessage message;
+        message.setAddress("/stats/" + getStageName((Stage)i));
+        message.addIntArg((int)summary.count);
+        message.addFloatArg(summary.p50 / 1000.0f);
+        message.addFloatArg(summary.p95 / 1000.0f);
+        message.addFloatArg(summary.p99 / 1000.0f);
+        message.addFloatArg(summary.max / 1000.0f);
+        bundle.addMessage(message);
+    }
+    
+    ofxOscMessage frames;
+    frames.setAddress("/stats/frames");
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        frames.addIntArg((int)counters[i]);
+        counters[i] = 0;
+    }
+    bundle.addMessage(frames);
+    sender.sendBundle(bundle);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "LatencyHistogram.h"
+
+// One latency histogram per pipeline stage. Stages are recorded from the
+// capture and GL threads and sent as one OSC bundle every interval, one
+// /stats/<stage> message each with count, p50, p95, p99 and max in
+// microseconds, plus the frame counters for the interval.
+
+class FrameStats {
+public:
+    enum Stage {
+        STAGE_DEVICE_WAIT,
+        STAGE_CAPTURE_COPY,
+        STAGE_FILTER_SPATIAL,
+        STAGE_FILTER_TEMPORAL,
+        STAGE_CONVERT_DEPTH,
+        STAGE_CONVERT_IR,
+        STAGE_CONVERT_RAW_DEPTH,
+        STAGE_CONVERT_FOREGROUND,
+        STAGE_BLOBS,
+        STAGE_CONVERT_POINTS,
+        STAGE_REGISTER_COLOUR,
+        STAGE_REGISTER_DEPTH,
+        STAGE_SCALE_COLOUR,
+        STAGE_FUSION,
+        STAGE_UPLOAD_COLOUR,
+        STAGE_UPLOAD_DEPTH,
+        STAGE_UPLOAD_IR,
+        STAGE_UPLOAD_RAW_DEPTH,
+        STAGE_UPLOAD_FOREGROUND,
+        STAGE_UPLOAD_POINTS,
+        STAGE_UPLOAD_REGISTERED_COLOUR,
+        STAGE_UPLOAD_COLOUR_DEPTH,
+        STAGE_UPLOAD_SCALED_COLOUR,
+        STAGE_UPLOAD_FUSION,
+        STAGE_SHADER_DEPTH,
+        STAGE_SHADER_IR,
+        STAGE_PUBLISH_COLOUR,
+        STAGE_PUBLISH_DEPTH,
+        STAGE_PUBLISH_IR,
+        STAGE_PUBLISH_RAW_DEPTH,
+        STAGE_PUBLISH_FOREGROUND,
+        STAGE_PUBLISH_POINTS,
+        STAGE_PUBLISH_REGISTERED_COLOUR,
+        STAGE_PUBLISH_COLOUR_DEPTH,
+        STAGE_PUBLISH_SCALED_COLOUR,
+        STAGE_PUBLISH_FUSION,
+        STAGE_PUBLISH_TRANSPORTS,
+        STAGE_OSC,
+        STAGE_CAPTURE_TO_PUBLISH,
+        STAGE_COUNT
+    };
+    
+    // frame counts, sent as /stats/frames received dropped duplicated
+    enum Counter {
+        COUNTER_RECEIVED,    // new frames picked up by the GL thread
+        COUNTER_DROPPED,     // captured but replaced before the GL thread saw them
+        COUNTER_DUPLICATED,  // published again with no new frame in between
+        COUNTER_COUNT
+    };
+    
+    static string getStageName(Stage stage);
+    
+    LatencyHistogram& get(Stage stage) {
+        return stages[stage];
+    }
+    
+    // GL thread only
+    void add(Counter counter, uint64_t count = 1) {
+        counters[counter] += count;
+        totals[counter] += count;
+    }
+    uint64_t getTotal(Counter counter) const {
+        return totals[counter];
+    }
+    
+    // interval in seconds, 0 disables sending
+    void setup(float interval);
+    // sends a bundle when the interval has passed
+    void update(ofxOscSender& sender);
+    
+private:
+    LatencyHistogram stages[STAGE_COUNT];
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint64_t totals[COUNTER_COUNT] = {};
+    float interval = 0;
+    float lastSendTime = 0;
+};
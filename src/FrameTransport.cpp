@@ -0,0 +1,27 @@
+#include "FrameTransport.h"
+
+size_t FrameTransportFormat::getBytesPerPixel(PixelFormat format)
+{
+    switch (format) {
+        case PIXELS_GREY8: return 1;
+        case PIXELS_RGBA8: return 4;
+        case PIXELS_BGRA8: return 4;
+        case PIXELS_GREY16: return 2;
+        case PIXELS_FLOAT32: return 4;
+        case PIXELS_RGB32F: return 12;
+        default: return 0;
+    }
+}
+
+std::string FrameTransportFormat::getName(PixelFormat format)
+{
+    switch (format) {
+        case PIXELS_GREY8: return "grey8";
+        case PIXELS_RGBA8: return "rgba8";
+        case PIXELS_BGRA8: return "bgra8";
+        case PIXELS_GREY16: return "grey16";
+        case PIXELS_FLOAT32: return "float32";
+        case PIXELS_RGB32F: return "rgb32f";
+        default: return "unknown";
+    }
+}
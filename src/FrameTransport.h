@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A way of getting a stream's frames out of the app other than Syphon.
+// Syphon shares GL textures and only exists on macOS; transports take frames
+// from memory, so they work headless and on any platform.
+//
+// The app opens a transport when the first frame of its stream arrives,
+// since only then is the format known, and from then on publishes every
+// frame while hasClients() says someone is reading.
+
+namespace FrameTransportFormat {
+
+    enum PixelFormat {
+        PIXELS_GREY8 = 1,
+        PIXELS_RGBA8 = 2,
+        PIXELS_BGRA8 = 3,
+        PIXELS_GREY16 = 4,
+        // depth and IR as they come from the device, mm and raw units
+        PIXELS_FLOAT32 = 5,
+        // camera space points, metres
+        PIXELS_RGB32F = 6
+    };
+    
+    size_t getBytesPerPixel(PixelFormat format);
+    std::string getName(PixelFormat format);
+
+}
+
+struct FrameFormat {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    FrameTransportFormat::PixelFormat pixelFormat = FrameTransportFormat::PIXELS_RGBA8;
+    
+    // rows are tightly packed
+    size_t getStride() const { return width * FrameTransportFormat::getBytesPerPixel(pixelFormat); }
+    size_t getSize() const { return getStride() * height; }
+};
+
+class FrameTransport {
+public:
+    virtual ~FrameTransport() {}
+    
+    // stream is the stream's short name, e.g. "colour"
+    virtual bool open(const std::string& stream, const FrameFormat& format) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    virtual const FrameFormat& getFormat() const = 0;
+    
+    // false lets the app skip work nobody reads; transports that cannot
+    // tell always return true
+    virtual bool hasClients() const = 0;
+    
+    // pixels holds getFormat().getSize() bytes. sequence is the capture
+    // sequence number, timestamp the capture time in ns (steady clock)
+    virtual void publish(const void* pixels, uint64_t sequence, uint64_t timestamp) = 0;
+    
+    virtual std::string getName() const = 0;
+};
@@ -0,0 +1,227 @@
+#include "FusionOutput.h"
+#include "PixelKernels.h"
+#include "NetworkTransport.h"
+#include "SharedMemoryTransport.h"
+
+// short names of FusionOutput::Stream, used in FUSION_SHM_STREAMS,
+// FUSION_NET_STREAMS and the transport names
+static const string streamNames[] = { "heightmap", "fusedpoints" };
+
+//========================================================================
+
+FusionOutput::FusionOutput(const Sensor::Shared& shared)
+: shared(shared)
+, stats(*shared.stats)
+{
+}
+
+void FusionOutput::setup(ofxXmlSettings& XML)
+{
+    hasHeightMap = XML.getValue("HAS_HEIGHT_MAP", 0);
+    hasPoints = XML.getValue("HAS_FUSED_POINTS", 0);
+    if (!isEnabled()) {
+        return;
+    }
+
+    vector<string> bounds = ofSplitString(XML.getValue("FUSION_AREA", "-2,-2,2,2"), ",", true, true);
+    if (bounds.size() == 4 && ofToFloat(bounds[0]) < ofToFloat(bounds[2]) && ofToFloat(bounds[1]) < ofToFloat(bounds[3])) {
+        area.minX = ofToFloat(bounds[0]);
+        area.minY = ofToFloat(bounds[1]);
+        area.maxX = ofToFloat(bounds[2]);
+        area.maxY = ofToFloat(bounds[3]);
+    }
+    else {
+        ofLogWarning() << "FUSION_AREA should be minX,minY,maxX,maxY in metres";
+    }
+    area.cellSize = XML.getValue("FUSION_CELL_SIZE", area.cellSize);
+    if (area.cellSize <= 0) {
+        ofLogWarning() << "FUSION_CELL_SIZE must be more than 0, using 0.02";
+        area.cellSize = 0.02f;
+    }
+    area.minHeight = XML.getValue("FUSION_MIN_HEIGHT", area.minHeight);
+    area.maxHeight = XML.getValue("FUSION_MAX_HEIGHT", area.maxHeight);
+
+    // next to the sensors' own streams, on the top level prefix and port
+    string prefix = XML.getValue("SHM_PREFIX", "kinectv2");
+    int slots = XML.getValue("SHM_SLOTS", 3);
+    for (int stream : parseStreams(XML, "FUSION_SHM_STREAMS")) {
+        transports[stream].push_back(unique_ptr<FrameTransport>(new SharedMemoryTransport(prefix, slots)));
+    }
+
+    NetworkTransport::Settings network;
+    network.protocol = XML.getValue("NET_PROTOCOL", "udp") == "tcp" ? NetworkTransport::PROTOCOL_TCP : NetworkTransport::PROTOCOL_UDP;
+    network.host = XML.getValue("NET_IP", XML.getValue("SENDIP", "127.0.0.1"));
+    network.port = XML.getValue("NET_PORT", 12340);
+    network.compress = XML.getValue("NET_COMPRESS", 1);
+    network.jpegQuality = XML.getValue("NET_JPEG_QUALITY", 80);
+    for (int stream : parseStreams(XML, "FUSION_NET_STREAMS")) {
+        transports[stream].push_back(unique_ptr<FrameTransport>(new NetworkTransport(network)));
+    }
+}
+
+void FusionOutput::setSensors(const vector<unique_ptr<Sensor>>& sensors)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    this->sensors = &sensors;
+    fusion.setup(sensors.size(), 512, 424, area);
+    for (size_t i = 0; i < sensors.size(); i++) {
+        fusion.setSensor(i, sensors[i]->getIntrinsics(), sensors[i]->getPose());
+    }
+    ofLogNotice() << "fusing " << sensors.size() << " sensors, height map " << fusion.getMapWidth() << "x" << fusion.getMapHeight();
+    if (shared.headless) {
+        return;
+    }
+
+    if (hasHeightMap) {
+        heightMapPixels.allocate(fusion.getMapWidth(), fusion.getMapHeight(), 4);
+        heightMapSyphon.setName("KinectV2 Height Map");
+    }
+    if (hasPoints) {
+        pointsPacked.allocate(1024, 424 * sensors.size(), 4);
+        pointsSyphon.setName("KinectV2 Fused Points");
+    }
+}
+
+void FusionOutput::addFrame(int index)
+{
+    if (isEnabled()) {
+        updated.push_back(index);
+    }
+}
+
+void FusionOutput::update()
+{
+    if (!isEnabled()) {
+        return;
+    }
+    heightMapConsumed = isConsumed(STREAM_HEIGHT_MAP, heightMapSyphon);
+    pointsConsumed = isConsumed(STREAM_POINTS, pointsSyphon);
+    bool mapping = hasHeightMap && heightMapConsumed;
+    if (updated.empty() || (!mapping && !(hasPoints && pointsConsumed))) {
+        updated.clear();
+        return;
+    }
+
+    // the sensors' depth is only valid until their next frame, so it is
+    // handed over just before it is used
+    uint64_t captureTime = 0;
+    for (int index : updated) {
+        const Sensor& sensor = *(*sensors)[index];
+        if (sensor.getDepth()) {
+            fusion.setDepth(index, sensor.getDepth()->getData(), sensor.getFlip());
+            captureTime = max(captureTime, sensor.getFrame().captureTime);
+        }
+    }
+    updated.clear();
+    {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_FUSION));
+        fusion.process(shared.pool, mapping);
+    }
+    sequence++;
+
+    const float* points = fusion.getPoints();
+    int mapWidth = fusion.getMapWidth();
+    int mapHeight = fusion.getMapHeight();
+    {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_TRANSPORTS));
+        if (mapping) {
+            publishTransports(STREAM_HEIGHT_MAP, fusion.getHeightMap(), mapWidth, mapHeight, FrameTransportFormat::PIXELS_FLOAT32, captureTime);
+        }
+        if (hasPoints) {
+            publishTransports(STREAM_POINTS, points, 512, 424 * fusion.getSensorCount(), FrameTransportFormat::PIXELS_RGB32F, captureTime);
+        }
+    }
+    if (shared.headless) {
+        return;
+    }
+
+    ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_FUSION));
+    if (mapping) {
+        PixelKernels::packDepth16(fusion.getHeightMap(), heightMapPixels.getData(), (size_t)mapWidth * mapHeight);
+        heightMapTex.loadData(heightMapPixels);
+    }
+    if (hasPoints && pointsConsumed) {
+        PointCloud::pack16(points, pointsPacked.getData(), fusion.getPointCount());
+        pointsTex.loadData(pointsPacked);
+    }
+}
+
+void FusionOutput::draw()
+{
+    if (hasHeightMap && heightMapConsumed && heightMapTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_FUSION));
+        heightMapSyphon.publishTexture(&heightMapTex);
+    }
+    if (hasPoints && pointsConsumed && pointsTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_FUSION));
+        pointsSyphon.publishTexture(&pointsTex);
+    }
+}
+
+void FusionOutput::exit()
+{
+    for (int i = 0; i < STREAM_COUNT; i++) {
+        transports[i].clear();
+    }
+}
+
+// headless there is no Syphon, everything is made
+bool FusionOutput::isConsumed(int stream, const SyphonOutput& output) const
+{
+    if (shared.headless || shared.alwaysUpload || output.hasClients()) {
+        return true;
+    }
+    for (const unique_ptr<FrameTransport>& transport : transports[stream]) {
+        if (!transport->isOpen() || transport->hasClients()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<int> FusionOutput::parseStreams(ofxXmlSettings& XML, const string& setting)
+{
+    const bool enabled[STREAM_COUNT] = { hasHeightMap, hasPoints };
+    vector<int> streams;
+    vector<string> names = ofSplitString(XML.getValue(setting, ""), ",", true, true);
+    for (size_t i = 0; i < names.size(); i++) {
+        int stream = find(streamNames, streamNames + STREAM_COUNT, names[i]) - streamNames;
+        if (stream == STREAM_COUNT) {
+            ofLogWarning() << setting << ": unknown stream " << names[i];
+        }
+        else if (!enabled[stream]) {
+            ofLogWarning() << setting << ": " << names[i] << " is not enabled";
+        }
+        else {
+            streams.push_back(stream);
+        }
+    }
+    return streams;
+}
+
+// the formats never change, transports are opened with the first result
+void FusionOutput::publishTransports(int stream, const void* pixels, int width, int height, FrameTransportFormat::PixelFormat format, uint64_t captureTime)
+{
+    FrameFormat frameFormat;
+    frameFormat.width = width;
+    frameFormat.height = height;
+    frameFormat.pixelFormat = format;
+    vector<unique_ptr<FrameTransport>>& streamTransports = transports[stream];
+    for (size_t i = 0; i < streamTransports.size(); ) {
+        FrameTransport& transport = *streamTransports[i];
+        if (!transport.isOpen()) {
+            if (!transport.open(streamNames[stream], frameFormat)) {
+                ofLogError() << "could not open " << transport.getName() << ", not publishing it";
+                streamTransports.erase(streamTransports.begin() + i);
+                continue;
+            }
+            ofLogNotice() << "publishing " << streamNames[stream] << " to " << transport.getName() << ", " << width << "x" << height << " " << FrameTransportFormat::getName(format);
+        }
+        if (transport.hasClients()) {
+            transport.publish(pixels, sequence, captureTime);
+        }
+        i++;
+    }
+}
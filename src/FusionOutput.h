@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SyphonOutput.h"
+#include "ofxXmlSettings.h"
+#include "DepthFusion.h"
+#include "FrameTransport.h"
+#include "Sensor.h"
+
+// Every sensor's depth merged by DepthFusion and published as one height map
+// of the floor and one point cloud, so consumers don't each have to merge
+// the sensors themselves. Runs on the GL thread after the sensors, whenever
+// at least one of them processed a new frame, and only while someone reads
+// an output.
+//
+// Through Syphon the height map is packed like raw depth, the points like
+// the "Points" stream. Shared memory and the network get the height map as
+// float32 mm and the points as RGB32F, one 512x424 block per sensor.
+
+class FusionOutput {
+public:
+    explicit FusionOutput(const Sensor::Shared& shared);
+    
+    // reads the settings, before the sensors are set up so they know
+    // whether to keep their depth for fusion
+    void setup(ofxXmlSettings& XML);
+    bool isEnabled() const { return hasHeightMap || hasPoints; }
+    // takes the sensors' calibrations and poses, once they are set up
+    void setSensors(const vector<unique_ptr<Sensor>>& sensors);
+    
+    // sensor index processed a new frame
+    void addFrame(int index);
+    void update();
+    // publishes to Syphon
+    void draw();
+    void exit();
+
+private:
+    enum Stream {
+        STREAM_HEIGHT_MAP,
+        STREAM_POINTS,
+        STREAM_COUNT
+    };
+    
+    bool isConsumed(int stream, const SyphonOutput& output) const;
+    vector<int> parseStreams(ofxXmlSettings& XML, const string& setting);
+    // captureTime is the newest of the frames that went in
+    void publishTransports(int stream, const void* pixels, int width, int height, FrameTransportFormat::PixelFormat format, uint64_t captureTime);
+    
+    const Sensor::Shared& shared;
+    FrameStats& stats;
+    bool hasHeightMap = false;
+    bool hasPoints = false;
+    DepthFusion::Area area;
+    DepthFusion fusion;
+    const vector<unique_ptr<Sensor>>* sensors = nullptr;
+    // sensors with a new frame since the last update()
+    vector<int> updated;
+    uint64_t sequence = 0;
+    
+    bool heightMapConsumed = true;
+    bool pointsConsumed = true;
+    ofPixels heightMapPixels;
+    ofTexture heightMapTex;
+    SyphonOutput heightMapSyphon;
+    ofPixels pointsPacked;
+    ofTexture pointsTex;
+    SyphonOutput pointsSyphon;
+    
+    vector<unique_ptr<FrameTransport>> transports[STREAM_COUNT];
+};
@@ -0,0 +1,121 @@
+#include "JpegDecoder.h"
+
+JpegDecoder::~JpegDecoder()
+{
+    stop();
+}
+
+void JpegDecoder::start(int workers, int queueDepth, int width, int height)
+{
+    stop();
+    this->width = width;
+    this->height = height;
+    slots.assign(max(queueDepth, 1), Slot());
+    for (Slot& slot : slots) {
+        slot.pixels.allocate(width, height, 4);
+    }
+    submitted = 0;
+    dispatched = 0;
+    taken = 0;
+    stopping = false;
+    for (int i = 0; i < max(workers, 1); i++) {
+        threads.push_back(thread(&JpegDecoder::workerLoop, this));
+    }
+}
+
+void JpegDecoder::stop()
+{
+    if (threads.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work.notify_all();
+    changed.notify_all();
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    threads.clear();
+    slots.clear();
+}
+
+void JpegDecoder::submit(const unsigned char* jpeg, size_t size)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return submitted - taken < slots.size() || stopping; });
+        if (stopping) {
+            return;
+        }
+        Slot& slot = slots[submitted % slots.size()];
+        slot.state = SLOT_QUEUED;
+        slot.jpeg = jpeg;
+        slot.size = size;
+        submitted++;
+    }
+    work.notify_one();
+}
+
+int JpegDecoder::getPending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (int)(submitted - taken);
+}
+
+bool JpegDecoder::next(ofPixels& pixels)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (taken == submitted) {
+        return false;
+    }
+    Slot& slot = slots[taken % slots.size()];
+    changed.wait(lock, [&] { return slot.state == SLOT_DONE || stopping; });
+    if (stopping) {
+        return false;
+    }
+    bool decoded = slot.decoded;
+    if (decoded) {
+        // the slot decodes into whatever buffer it gets back next time
+        pixels.swap(slot.pixels);
+    }
+    slot.state = SLOT_FREE;
+    taken++;
+    lock.unlock();
+    changed.notify_all();
+    return decoded;
+}
+
+void JpegDecoder::workerLoop()
+{
+    tjhandle decompressor = tjInitDecompress();
+    while (true) {
+        Slot* slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work.wait(lock, [this] { return dispatched < submitted || stopping; });
+            if (stopping) {
+                break;
+            }
+            // the oldest queued frame, so frames finish roughly in order
+            slot = &slots[dispatched % slots.size()];
+            slot->state = SLOT_DECODING;
+            dispatched++;
+        }
+
+        // the slot belongs to this worker until it is marked done
+        slot->decoded = tjDecompress2(decompressor, slot->jpeg, slot->size, slot->pixels.getData(),
+                                      width, 0, height, TJPF_RGBA, TJFLAG_FASTDCT) == 0;
+        if (!slot->decoded) {
+            ofLogWarning() << "jpeg decode failed: " << tjGetErrorStr();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot->state = SLOT_DONE;
+        }
+        changed.notify_all();
+    }
+    tjDestroy(decompressor);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ofMain.h"
+#include "turbojpeg.h"
+#include <condition_variable>
+
+// Decodes a stream of JPEG frames on several threads at once. submit() hands
+// frames in in order, each is picked up by the next idle worker, and next()
+// gives them back in the order they were submitted: a frame that takes
+// longer holds back the ones behind it in the queue instead of letting them
+// overtake. Decoded pixels are swapped out, not copied, so next() needs
+// pixels of the decode size to swap in.
+//
+// One thread submits and takes, normally the capture thread. A single
+// turbojpeg decoder manages well under 30 full HD frames a second on older
+// machines, a few workers decoding consecutive frames keep up.
+
+class JpegDecoder {
+public:
+    ~JpegDecoder();
+
+    // queueDepth frames can be submitted and not yet taken
+    void start(int workers, int queueDepth, int width, int height);
+    void stop();
+    bool isRunning() const { return !threads.empty(); }
+
+    // the JPEG must stay valid until its frame is taken. Blocks while the
+    // queue is full
+    void submit(const unsigned char* jpeg, size_t size);
+    // frames submitted and not taken yet
+    int getPending() const;
+    // waits for the oldest submitted frame and swaps it into pixels. False
+    // if nothing is pending or the frame failed to decode, pixels are then
+    // left as they were
+    bool next(ofPixels& pixels);
+
+private:
+    enum State {
+        SLOT_FREE,
+        SLOT_QUEUED,
+        SLOT_DECODING,
+        SLOT_DONE
+    };
+
+    struct Slot {
+        State state = SLOT_FREE;
+        const unsigned char* jpeg = nullptr;
+        size_t size = 0;
+        bool decoded = false;
+        ofPixels pixels;
+    };
+
+    void workerLoop();
+
+    vector<thread> threads;
+    vector<Slot> slots;
+    int width = 0;
+    int height = 0;
+
+    // frames are numbered as they are submitted, frame n lives in slot
+    // n % slots.size()
+    uint64_t submitted = 0;
+    uint64_t dispatched = 0;
+    uint64_t taken = 0;
+    bool stopping = false;
+
+    mutable std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable changed;
+};
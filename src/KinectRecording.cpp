@@ -0,0 +1,218 @@
+#include "KinectRecording.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace KinectRecording;
+
+namespace {
+
+    const char FILE_MAGIC[8] = { 'K', 'V', '2', 'R', 'E', 'C', 0, 0 };
+
+    size_t padded(size_t size) {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+}
+
+//--------------------------------------------------------------
+Writer::~Writer()
+{
+    close();
+}
+
+bool Writer::open(const std::string& path, uint32_t streams, uint32_t colorWidth, uint32_t colorHeight, uint32_t depthWidth, uint32_t depthHeight)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = VERSION;
+    header.streams = streams;
+    header.colorWidth = colorWidth;
+    header.colorHeight = colorHeight;
+    header.depthWidth = depthWidth;
+    header.depthHeight = depthHeight;
+
+    offset = 0;
+    index.clear();
+    return writePadded(&header, sizeof(header));
+}
+
+bool Writer::writePadded(const void* data, size_t size)
+{
+    static const unsigned char zeros[ALIGNMENT] = {};
+    size_t padding = padded(size) - size;
+    if (fwrite(data, 1, size, file) != size || fwrite(zeros, 1, padding, file) != padding) {
+        return false;
+    }
+    offset += size + padding;
+    return true;
+}
+
+bool Writer::write(uint64_t sequence, uint64_t timestamp, const unsigned char* jpeg, size_t jpegSize, const float* depth, const float* ir)
+{
+    if (!file) {
+        return false;
+    }
+    size_t planeSize = header.depthWidth * header.depthHeight * sizeof(float);
+
+    FrameHeader frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = FRAME_MAGIC;
+    frame.sequence = sequence;
+    frame.timestamp = timestamp;
+    frame.colorSize = jpeg ? (uint32_t)jpegSize : 0;
+    frame.depthSize = depth ? (uint32_t)planeSize : 0;
+    frame.irSize = ir ? (uint32_t)planeSize : 0;
+    frame.recordSize = (uint32_t)(padded(sizeof(frame)) + padded(frame.colorSize) + padded(frame.depthSize) + padded(frame.irSize));
+
+    IndexEntry entry = { offset, timestamp };
+    bool ok = writePadded(&frame, sizeof(frame));
+    ok = ok && (!jpeg || writePadded(jpeg, jpegSize));
+    ok = ok && (!depth || writePadded(depth, planeSize));
+    ok = ok && (!ir || writePadded(ir, planeSize));
+    if (ok) {
+        index.push_back(entry);
+    }
+    return ok;
+}
+
+void Writer::close()
+{
+    if (!file) {
+        return;
+    }
+    header.indexOffset = offset;
+    header.frameCount = index.size();
+    if (!index.empty()) {
+        fwrite(index.data(), sizeof(IndexEntry), index.size(), file);
+    }
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fclose(file);
+    file = nullptr;
+}
+
+//--------------------------------------------------------------
+Reader::~Reader()
+{
+    close();
+}
+
+bool Reader::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(FileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    data = (const unsigned char*)mapped;
+    size = info.st_size;
+    // playback walks the file front to back
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != VERSION) {
+        close();
+        return false;
+    }
+
+    // an index of nothing or pointing anywhere else than at whole records
+    // is as good as none, a recording without frames can't be played
+    if (header.frameCount && header.frameCount <= size / sizeof(IndexEntry) && header.indexOffset && header.indexOffset <= size - header.frameCount * sizeof(IndexEntry)) {
+        index.resize(header.frameCount);
+        memcpy(index.data(), data + header.indexOffset, header.frameCount * sizeof(IndexEntry));
+        for (const IndexEntry& entry : index) {
+            if (!isRecord(entry.offset)) {
+                index.clear();
+                break;
+            }
+        }
+    }
+    if (index.empty() && !rebuildIndex()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// a whole frame record within the file whose planes are the header's size
+bool Reader::isRecord(uint64_t offset) const
+{
+    if (offset % ALIGNMENT || offset > size || size - offset < sizeof(FrameHeader)) {
+        return false;
+    }
+    FrameHeader frame;
+    memcpy(&frame, data + offset, sizeof(frame));
+    size_t planeSize = (size_t)header.depthWidth * header.depthHeight * sizeof(float);
+    return frame.magic == FRAME_MAGIC
+        && (!frame.depthSize || frame.depthSize == planeSize)
+        && (!frame.irSize || frame.irSize == planeSize)
+        && frame.recordSize >= padded(sizeof(frame)) + padded(frame.colorSize) + padded(frame.depthSize) + padded(frame.irSize)
+        && frame.recordSize <= size - offset;
+}
+
+// for files that were never closed, stops at the first incomplete record
+bool Reader::rebuildIndex()
+{
+    index.clear();
+    size_t offset = padded(sizeof(FileHeader));
+    while (offset + sizeof(FrameHeader) <= size) {
+        if (!isRecord(offset)) {
+            break;
+        }
+        FrameHeader frame;
+        memcpy(&frame, data + offset, sizeof(frame));
+        IndexEntry entry = { offset, frame.timestamp };
+        index.push_back(entry);
+        offset += frame.recordSize;
+    }
+    return !index.empty();
+}
+
+void Reader::close()
+{
+    if (data) {
+        munmap((void*)data, size);
+    }
+    data = nullptr;
+    size = 0;
+    index.clear();
+}
+
+FrameView Reader::getFrame(size_t i) const
+{
+    const unsigned char* record = data + index[i].offset;
+    FrameHeader frame;
+    memcpy(&frame, record, sizeof(frame));
+
+    FrameView view;
+    view.sequence = frame.sequence;
+    view.timestamp = frame.timestamp;
+    const unsigned char* payload = record + padded(sizeof(frame));
+    view.jpeg = frame.colorSize ? payload : nullptr;
+    view.jpegSize = frame.colorSize;
+    payload += padded(frame.colorSize);
+    view.depth = frame.depthSize ? (const float*)payload : nullptr;
+    payload += padded(frame.depthSize);
+    view.ir = frame.irSize ? (const float*)payload : nullptr;
+    return view;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Container for recorded Kinect streams.
+//
+//   FileHeader
+//   frame record: FrameHeader, colour JPEG, depth float32, IR float32
+//   frame record ...
+//   index: one IndexEntry per frame
+//
+// Every record and payload starts on a 64 byte boundary so the depth and IR
+// planes can be used straight out of the memory mapped file. The header is
+// rewritten with the index position when the writer closes; a file that was
+// never closed (crash, power loss) is still readable, the reader rebuilds the
+// index by walking the frame records.
+
+namespace KinectRecording {
+
+    const uint32_t VERSION = 1;
+    const uint32_t FRAME_MAGIC = 0x454d5246; // "FRME"
+    const size_t ALIGNMENT = 64;
+
+    enum Stream {
+        STREAM_COLOUR = 1 << 0,
+        STREAM_DEPTH = 1 << 1,
+        STREAM_IR = 1 << 2
+    };
+
+    struct FileHeader {
+        char magic[8];  // "KV2REC\0\0"
+        uint32_t version;
+        uint32_t streams;
+        uint32_t colorWidth;
+        uint32_t colorHeight;
+        uint32_t depthWidth;
+        uint32_t depthHeight;
+        uint64_t indexOffset;  // 0 until the writer is closed
+        uint64_t frameCount;
+    };
+
+    struct FrameHeader {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t sequence;
+        uint64_t timestamp;  // ns, steady clock of the recording machine
+        uint32_t colorSize;  // JPEG bytes, 0 if the stream is absent
+        uint32_t depthSize;
+        uint32_t irSize;
+        uint32_t recordSize; // header and padded payloads, offset to the next record
+    };
+
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t timestamp;
+    };
+
+    // a frame inside the mapped file, pointers stay valid until the reader closes
+    struct FrameView {
+        uint64_t sequence;
+        uint64_t timestamp;
+        const unsigned char* jpeg;
+        size_t jpegSize;
+        const float* depth;
+        const float* ir;
+    };
+
+    class Writer {
+    public:
+        ~Writer();
+
+        bool open(const std::string& path, uint32_t streams, uint32_t colorWidth, uint32_t colorHeight, uint32_t depthWidth, uint32_t depthHeight);
+        // depth and ir are depthWidth * depthHeight floats, pass null for absent streams
+        bool write(uint64_t sequence, uint64_t timestamp, const unsigned char* jpeg, size_t jpegSize, const float* depth, const float* ir);
+        // writes the index and the final header
+        void close();
+
+        bool isOpen() const { return file != nullptr; }
+        uint64_t getFrameCount() const { return index.size(); }
+
+    private:
+        bool writePadded(const void* data, size_t size);
+
+        FILE* file = nullptr;
+        FileHeader header;
+        uint64_t offset = 0;
+        std::vector<IndexEntry> index;
+    };
+
+    class Reader {
+    public:
+        ~Reader();
+
+        // fails on files without a single whole frame
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const { return data != nullptr; }
+        const FileHeader& getHeader() const { return header; }
+        size_t getFrameCount() const { return index.size(); }
+        FrameView getFrame(size_t index) const;
+
+    private:
+        bool rebuildIndex();
+        bool isRecord(uint64_t offset) const;
+
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        FileHeader header;
+        std::vector<IndexEntry> index;
+    };
+
+}
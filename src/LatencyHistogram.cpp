@@ -0,0 +1,88 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+: maxValue(0)
+{
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        buckets[i] = 0;
+    }
+}
+
+// values below 16 get a bucket each, above that every power of two is split
+// into 16 linear steps
+int LatencyHistogram::getBucket(uint64_t nanoseconds)
+{
+    if (nanoseconds < SUB_BUCKETS) {
+        return (int)nanoseconds;
+    }
+    int magnitude = 63;
+    while (!(nanoseconds >> magnitude)) {
+        magnitude--;
+    }
+    if (magnitude > MAX_MAGNITUDE) {
+        return NUM_BUCKETS - 1;
+    }
+    int subBucket = (int)(nanoseconds >> (magnitude - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+// middle of the range covered by a bucket
+uint64_t LatencyHistogram::getBucketValue(int bucket)
+{
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int magnitude = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    int subBucket = bucket % SUB_BUCKETS;
+    uint64_t step = 1ULL << (magnitude - SUB_BUCKET_BITS);
+    return (1ULL << magnitude) + subBucket * step + step / 2;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    buckets[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t previous = maxValue.load(std::memory_order_relaxed);
+    while (nanoseconds > previous && !maxValue.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Summary LatencyHistogram::snapshot()
+{
+    uint32_t counts[NUM_BUCKETS];
+    Summary summary = { 0, 0, 0, 0, 0 };
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        counts[i] = buckets[i].exchange(0, std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    summary.max = maxValue.exchange(0, std::memory_order_relaxed);
+    if (!summary.count) {
+        return summary;
+    }
+    
+    // a percentile is the first bucket whose running total reaches it
+    uint64_t p50 = (summary.count * 50 + 99) / 100;
+    uint64_t p95 = (summary.count * 95 + 99) / 100;
+    uint64_t p99 = (summary.count * 99 + 99) / 100;
+    uint64_t total = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        if (!counts[i]) {
+            continue;
+        }
+        uint64_t previous = total;
+        total += counts[i];
+        uint64_t value = getBucketValue(i);
+        if (value > summary.max) {
+            value = summary.max;
+        }
+        if (previous < p50 && total >= p50) {
+            summary.p50 = value;
+        }
+        if (previous < p95 && total >= p95) {
+            summary.p95 = value;
+        }
+        if (previous < p99 && total >= p99) {
+            summary.p99 = value;
+        }
+    }
+    return summary;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// HDR style latency histogram: log-linear buckets with 16 steps per power of
+// two, so any value from 1 ns to ~18 minutes is kept to within 1/16 of its
+// size. record() is lock free and can be called from any thread; snapshot()
+// reads and clears the buckets, so each snapshot covers the time since the
+// previous one.
+
+class LatencyHistogram {
+public:
+    struct Summary {
+        uint64_t count;
+        // nanoseconds
+        uint64_t p50;
+        uint64_t p95;
+        uint64_t p99;
+        uint64_t max;
+    };
+    
+    LatencyHistogram();
+    
+    void record(uint64_t nanoseconds);
+    Summary snapshot();
+    
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_MAGNITUDE = 40;
+    static const int NUM_BUCKETS = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+    
+private:
+    static int getBucket(uint64_t nanoseconds);
+    static uint64_t getBucketValue(int bucket);
+    
+    std::atomic<uint32_t> buckets[NUM_BUCKETS];
+    std::atomic<uint64_t> maxValue;
+};
+
+// records the lifetime of the scope into a histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& histogram)
+    : histogram(histogram)
+    , start(std::chrono::steady_clock::now())
+    {
+    }
+    
+    ~ScopedTimer() {
+        histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,307 @@
+#include "NetworkReceiver.h"
+#include "DepthCodec.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+    // nothing the sender makes comes near this, encoded or decoded,
+    // anything larger is garbage
+    const uint32_t MAX_FRAME_SIZE = 64 << 20;
+    // frames further back than this are a sender that started again
+    const int32_t REORDER_WINDOW = 30;
+
+    void setNonBlocking(int fd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    std::string getStreamName(const NetworkStream::PacketHeader& header)
+    {
+        return std::string(header.stream, strnlen(header.stream, NetworkStream::STREAM_NAME_SIZE));
+    }
+
+}
+
+NetworkReceiver::~NetworkReceiver()
+{
+    close();
+}
+
+bool NetworkReceiver::open(int port, Protocol protocol)
+{
+    close();
+    this->protocol = protocol;
+    socket = ::socket(AF_INET, protocol == PROTOCOL_UDP ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (socket < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // room for a few frames worth of datagrams while the caller is busy
+    int bufferSize = 16 << 20;
+    setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket, (sockaddr*)&address, sizeof(address)) != 0 || (protocol == PROTOCOL_TCP && listen(socket, 8) != 0)) {
+        close();
+        return false;
+    }
+    setNonBlocking(socket);
+    packet.resize(sizeof(NetworkStream::PacketHeader) + NetworkStream::MAX_PAYLOAD);
+    stats = Stats();
+#ifdef HAVE_TURBOJPEG
+    decompressor = tjInitDecompress();
+#endif
+    return true;
+}
+
+void NetworkReceiver::close()
+{
+    for (Connection& connection : connections) {
+        ::close(connection.socket);
+    }
+    connections.clear();
+    if (socket >= 0) {
+        ::close(socket);
+        socket = -1;
+    }
+    streams.clear();
+#ifdef HAVE_TURBOJPEG
+    if (decompressor) {
+        tjDestroy(decompressor);
+        decompressor = nullptr;
+    }
+#endif
+}
+
+bool NetworkReceiver::receive(Frame& frame, int timeoutMs)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::vector<pollfd> waiting;
+    while (true) {
+        if (protocol == PROTOCOL_UDP) {
+            if (receiveUdp(frame)) {
+                return true;
+            }
+        }
+        else {
+            for (size_t i = 0; i < connections.size(); ) {
+                bool closed = false;
+                if (receiveTcp(connections[i], frame, closed)) {
+                    return true;
+                }
+                if (closed) {
+                    ::close(connections[i].socket);
+                    connections.erase(connections.begin() + i);
+                    continue;
+                }
+                i++;
+            }
+            int accepted;
+            while ((accepted = accept(socket, nullptr, nullptr)) >= 0) {
+                setNonBlocking(accepted);
+                Connection connection;
+                connection.socket = accepted;
+                connections.push_back(connection);
+            }
+        }
+
+        int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            return false;
+        }
+        waiting.assign(1, pollfd { socket, POLLIN, 0 });
+        for (Connection& connection : connections) {
+            waiting.push_back(pollfd { connection.socket, POLLIN, 0 });
+        }
+        if (poll(waiting.data(), waiting.size(), remaining) <= 0) {
+            return false;
+        }
+    }
+}
+
+bool NetworkReceiver::receiveUdp(Frame& frame)
+{
+    const size_t headerSize = sizeof(NetworkStream::PacketHeader);
+    while (true) {
+        ssize_t size = recv(socket, packet.data(), packet.size(), 0);
+        if (size < 0) {
+            return false;
+        }
+        NetworkStream::PacketHeader header;
+        if ((size_t)size < headerSize) {
+            stats.badPackets++;
+            continue;
+        }
+        memcpy(&header, packet.data(), headerSize);
+        if (!isValid(header) || header.payloadSize != size - headerSize || header.chunk >= header.chunkCount
+            || (uint64_t)header.chunkOffset + header.payloadSize > header.frameSize) {
+            stats.badPackets++;
+            continue;
+        }
+
+        Assembly& stream = streams[getStreamName(header)];
+        if (!stream.started || header.frame != stream.header.frame) {
+            int32_t age = stream.hasLast ? (int32_t)(header.frame - stream.last) : 1;
+            if (age <= 0 && age > -REORDER_WINDOW) {
+                // a late packet of a frame that is complete or given up on
+                continue;
+            }
+            if (stream.started) {
+                stats.incompleteFrames++;
+            }
+            countLost(stream, header.frame);
+            stream.header = header;
+            stream.data.resize(header.frameSize);
+            stream.received.assign(header.chunkCount, false);
+            stream.receivedCount = 0;
+            stream.started = true;
+        }
+        if (header.frameSize != stream.header.frameSize || header.chunkCount != stream.header.chunkCount) {
+            stats.badPackets++;
+            continue;
+        }
+        if (!stream.received[header.chunk]) {
+            memcpy(stream.data.data() + header.chunkOffset, packet.data() + headerSize, header.payloadSize);
+            stream.received[header.chunk] = true;
+            stream.receivedCount++;
+        }
+        if (stream.receivedCount == stream.header.chunkCount) {
+            stream.started = false;
+            if (decode(stream.header, stream.data, frame)) {
+                stats.frames++;
+                return true;
+            }
+            stats.badPackets++;
+        }
+    }
+}
+
+bool NetworkReceiver::receiveTcp(Connection& connection, Frame& frame, bool& closed)
+{
+    const size_t headerSize = sizeof(NetworkStream::PacketHeader);
+    while (true) {
+        bool inHeader = connection.headerRead < headerSize;
+        unsigned char* target = inHeader ? (unsigned char*)&connection.header + connection.headerRead : connection.data.data() + connection.dataRead;
+        size_t wanted = inHeader ? headerSize - connection.headerRead : connection.data.size() - connection.dataRead;
+        if (wanted) {
+            ssize_t size = recv(connection.socket, target, wanted, 0);
+            if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return false;
+            }
+            if (size <= 0) {
+                closed = true;
+                return false;
+            }
+            if (inHeader) {
+                connection.headerRead += size;
+                if (connection.headerRead < headerSize) {
+                    continue;
+                }
+                // a stream that makes no sense can't be resynchronised
+                if (!isValid(connection.header)) {
+                    stats.badPackets++;
+                    closed = true;
+                    return false;
+                }
+                connection.data.resize(connection.header.frameSize);
+                connection.dataRead = 0;
+                continue;
+            }
+            connection.dataRead += size;
+            if (connection.dataRead < connection.data.size()) {
+                continue;
+            }
+        }
+
+        connection.headerRead = 0;
+        Assembly& stream = streams[getStreamName(connection.header)];
+        countLost(stream, connection.header.frame);
+        if (decode(connection.header, connection.data, frame)) {
+            stats.frames++;
+            return true;
+        }
+        stats.badPackets++;
+    }
+}
+
+bool NetworkReceiver::isValid(const NetworkStream::PacketHeader& header) const
+{
+    return header.magic == NetworkStream::MAGIC && header.version == NetworkStream::VERSION
+        && header.headerSize == sizeof(NetworkStream::PacketHeader) && header.chunkCount > 0
+        && header.frameSize <= MAX_FRAME_SIZE
+        && FrameTransportFormat::getBytesPerPixel((FrameTransportFormat::PixelFormat)header.pixelFormat) > 0
+        // the decoded frame is allocated from the header alone
+        && (uint64_t)header.width * header.height * FrameTransportFormat::getBytesPerPixel((FrameTransportFormat::PixelFormat)header.pixelFormat) <= MAX_FRAME_SIZE;
+}
+
+void NetworkReceiver::countLost(Assembly& stream, uint32_t frame)
+{
+    int32_t gap = (int32_t)(frame - stream.last) - 1;
+    if (stream.hasLast && gap > 0) {
+        stats.lostFrames += gap;
+    }
+    stream.last = frame;
+    stream.hasLast = true;
+}
+
+bool NetworkReceiver::decode(const NetworkStream::PacketHeader& header, const std::vector<unsigned char>& data, Frame& frame)
+{
+    frame.stream = getStreamName(header);
+    frame.frame = header.frame;
+    frame.sequence = header.sequence;
+    frame.timestamp = header.timestamp;
+    frame.format.width = header.width;
+    frame.format.height = header.height;
+    frame.format.pixelFormat = (FrameTransportFormat::PixelFormat)header.pixelFormat;
+    frame.codec = NetworkStream::CODEC_NONE;
+    size_t size = frame.format.getSize();
+
+    switch (header.codec) {
+        case NetworkStream::CODEC_NONE:
+            if (data.size() != size) {
+                return false;
+            }
+            frame.pixels.assign(data.begin(), data.end());
+            return true;
+        case NetworkStream::CODEC_RVL:
+            if (frame.format.pixelFormat != FrameTransportFormat::PIXELS_GREY16) {
+                return false;
+            }
+            frame.pixels.resize(size);
+            return DepthCodec::decode(data.data(), data.size(), (uint16_t*)frame.pixels.data(), header.width * header.height);
+        case NetworkStream::CODEC_JPEG: {
+            // turbojpeg writes 4 bytes a pixel, anything else would overrun
+            if (frame.format.pixelFormat != FrameTransportFormat::PIXELS_RGBA8 && frame.format.pixelFormat != FrameTransportFormat::PIXELS_BGRA8) {
+                return false;
+            }
+#ifdef HAVE_TURBOJPEG
+            int jpegWidth, jpegHeight, subsampling, colourspace;
+            if (tjDecompressHeader3(decompressor, data.data(), data.size(), &jpegWidth, &jpegHeight, &subsampling, &colourspace) != 0 ||
+                jpegWidth != header.width || jpegHeight != header.height) {
+                return false;
+            }
+            frame.pixels.resize(size);
+            return tjDecompress2(decompressor, data.data(), data.size(), frame.pixels.data(), header.width, 0, header.height,
+                                 frame.format.pixelFormat == FrameTransportFormat::PIXELS_BGRA8 ? TJPF_BGRA : TJPF_RGBA, TJFLAG_FASTDCT) == 0;
+#else
+            frame.codec = NetworkStream::CODEC_JPEG;
+            frame.pixels.assign(data.begin(), data.end());
+            return true;
+#endif
+        }
+        default:
+            return false;
+    }
+}
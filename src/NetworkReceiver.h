@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FrameTransport.h"
+#include "NetworkStream.h"
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+// The receiving end of NET_STREAMS, for other machines: listens on a port,
+// puts the packets of each stream back together and decodes the frames.
+// Needs only the standard library and POSIX sockets, plus turbojpeg for
+// colour when built with HAVE_TURBOJPEG; without it JPEG frames are handed
+// over as they arrived.
+//
+//   NetworkReceiver receiver;
+//   receiver.open(12340, NetworkReceiver::PROTOCOL_UDP);
+//   NetworkReceiver::Frame frame;
+//   while (running) {
+//       if (receiver.receive(frame, 100) && frame.stream == "depth") {
+//           // frame.pixels is width * height uint16 mm
+//       }
+//   }
+//
+// Over TCP several senders (one per stream) can be connected at once.
+
+class NetworkReceiver {
+public:
+    enum Protocol {
+        PROTOCOL_UDP,
+        PROTOCOL_TCP
+    };
+    
+    struct Frame {
+        std::string stream;
+        uint32_t frame = 0;
+        uint64_t sequence = 0;
+        // capture time, steady clock ns of the sending machine
+        uint64_t timestamp = 0;
+        FrameFormat format;
+        // CODEC_NONE once decoded, CODEC_JPEG when there is no turbojpeg
+        NetworkStream::Codec codec = NetworkStream::CODEC_NONE;
+        std::vector<unsigned char> pixels;
+    };
+    
+    struct Stats {
+        uint64_t frames = 0;
+        // frames the sender numbered that never arrived
+        uint64_t lostFrames = 0;
+        // frames that arrived without all their packets
+        uint64_t incompleteFrames = 0;
+        // packets that were not ours or made no sense, frames that failed
+        // to decode
+        uint64_t badPackets = 0;
+    };
+    
+    ~NetworkReceiver();
+    
+    bool open(int port, Protocol protocol);
+    void close();
+    bool isOpen() const { return socket >= 0; }
+    
+    // waits up to timeoutMs for the next complete frame of any stream
+    bool receive(Frame& frame, int timeoutMs);
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Assembly {
+        NetworkStream::PacketHeader header = {};
+        std::vector<unsigned char> data;
+        std::vector<bool> received;
+        size_t receivedCount = 0;
+        bool started = false;
+        bool hasLast = false;
+        uint32_t last = 0;
+    };
+    
+    struct Connection {
+        int socket = -1;
+        NetworkStream::PacketHeader header = {};
+        size_t headerRead = 0;
+        std::vector<unsigned char> data;
+        size_t dataRead = 0;
+    };
+    
+    bool receiveUdp(Frame& frame);
+    // true with a frame, false when there is nothing more to read for now
+    bool receiveTcp(Connection& connection, Frame& frame, bool& closed);
+    bool isValid(const NetworkStream::PacketHeader& header) const;
+    // counts frames that went missing before this one
+    void countLost(Assembly& stream, uint32_t frame);
+    bool decode(const NetworkStream::PacketHeader& header, const std::vector<unsigned char>& data, Frame& frame);
+    
+    Protocol protocol = PROTOCOL_UDP;
+    int socket = -1;
+    std::vector<Connection> connections;
+    std::map<std::string, Assembly> streams;
+    std::vector<unsigned char> packet;
+    Stats stats;
+#ifdef HAVE_TURBOJPEG
+    tjhandle decompressor = nullptr;
+#endif
+};
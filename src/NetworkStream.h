@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Wire format of the network outputs (NET_STREAMS), shared by
+// NetworkTransport, which sends, and NetworkReceiver.
+//
+// A frame is encoded (see Codec), then sent as packets of a PacketHeader
+// followed by a piece of the encoded frame. Over UDP the pieces are at most
+// MAX_PAYLOAD bytes so every datagram fits a 1500 byte Ethernet MTU and no
+// IP fragmentation happens; a frame that misses a piece is dropped by the
+// receiver. Over TCP a frame goes out as a single packet. Frames are
+// numbered per stream by the sender, so a gap in the numbers is a frame
+// that was lost on the way or skipped because the link could not keep up.
+//
+// Every field is little endian.
+
+namespace NetworkStream {
+
+    const uint32_t MAGIC = 0x4e32564b; // "KV2N"
+    const uint16_t VERSION = 1;
+    // 1500 MTU less the IP and UDP headers and ours
+    const size_t MAX_PAYLOAD = 1472 - 64;
+    const size_t STREAM_NAME_SIZE = 16;
+    
+    enum Codec {
+        CODEC_NONE = 0,
+        // GREY16 pixels, see DepthCodec
+        CODEC_RVL = 1,
+        CODEC_JPEG = 2
+    };
+
+#pragma pack(push, 1)
+    struct PacketHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;     // sizeof(PacketHeader), payload follows
+        char stream[STREAM_NAME_SIZE];  // "depth", zero padded
+        uint32_t frame;          // per stream, counts every frame sent
+        uint64_t sequence;       // capture sequence
+        uint64_t timestamp;      // capture time, steady clock ns of the sender
+        uint16_t width;
+        uint16_t height;
+        uint8_t pixelFormat;     // FrameTransportFormat::PixelFormat once decoded
+        uint8_t codec;
+        uint16_t chunkCount;
+        uint16_t chunk;
+        uint16_t payloadSize;    // bytes after this header, UDP only, 0 over TCP
+        uint32_t frameSize;      // encoded bytes of the whole frame
+        uint32_t chunkOffset;    // where this payload goes in the encoded frame
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(PacketHeader) == 64, "packets are laid out for a 64 byte header");
+
+}
@@ -0,0 +1,308 @@
+#include "NetworkTransport.h"
+#include "DepthCodec.h"
+#include "PixelKernels.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+namespace {
+
+    // resolves host and makes a socket connected to it, UDP sockets only
+    // remember the address. TCP connects time out after timeoutMs
+    int openSocket(const string& host, int port, int type, int timeoutMs)
+    {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = type;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), ofToString(port).c_str(), &hints, &addresses) != 0 || !addresses) {
+            return -1;
+        }
+        int fd = ::socket(AF_INET, type, 0);
+        if (fd >= 0) {
+#ifdef SO_NOSIGPIPE
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            // a whole uncompressed frame should fit the send buffer
+            int bufferSize = 8 << 20;
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+            int flags = fcntl(fd, F_GETFL, 0);
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+            bool connected = ::connect(fd, addresses->ai_addr, addresses->ai_addrlen) == 0;
+            if (!connected && errno == EINPROGRESS) {
+                pollfd waiting = { fd, POLLOUT, 0 };
+                int error = 0;
+                socklen_t length = sizeof(error);
+                connected = poll(&waiting, 1, timeoutMs) == 1
+                    && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+            }
+            fcntl(fd, F_SETFL, flags);
+            if (!connected) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        return fd;
+    }
+
+    // false if the connection failed
+    bool sendAll(int fd, const unsigned char* data, size_t size)
+    {
+        while (size) {
+            ssize_t sent = ::send(fd, data, size, SEND_FLAGS);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+}
+
+NetworkTransport::NetworkTransport(const Settings& settings)
+: settings(settings)
+{
+}
+
+NetworkTransport::~NetworkTransport()
+{
+    close();
+}
+
+bool NetworkTransport::open(const std::string& stream, const FrameFormat& format)
+{
+    close();
+    this->stream = stream;
+    this->format = format;
+
+    // float depth and IR travel as 16 bit, which loses nothing the sensor
+    // measures
+    header = NetworkStream::PacketHeader();
+    header.magic = NetworkStream::MAGIC;
+    header.version = NetworkStream::VERSION;
+    header.headerSize = sizeof(NetworkStream::PacketHeader);
+    strncpy(header.stream, stream.c_str(), NetworkStream::STREAM_NAME_SIZE - 1);
+    header.width = format.width;
+    header.height = format.height;
+    header.pixelFormat = format.pixelFormat;
+    header.codec = NetworkStream::CODEC_NONE;
+    size_t pendingSize = format.getSize();
+    if (format.pixelFormat == FrameTransportFormat::PIXELS_FLOAT32) {
+        header.pixelFormat = FrameTransportFormat::PIXELS_GREY16;
+        pendingSize = format.width * format.height * sizeof(uint16_t);
+    }
+    if (settings.compress && header.pixelFormat == FrameTransportFormat::PIXELS_GREY16) {
+        header.codec = NetworkStream::CODEC_RVL;
+        encoded.resize(DepthCodec::getMaxEncodedSize(format.width * format.height));
+    }
+    if (settings.compress && (format.pixelFormat == FrameTransportFormat::PIXELS_RGBA8 || format.pixelFormat == FrameTransportFormat::PIXELS_BGRA8)) {
+        header.codec = NetworkStream::CODEC_JPEG;
+        compressor = tjInitCompress();
+        jpeg = tjAlloc(tjBufSize(format.width, format.height, TJSAMP_420));
+    }
+    pending.resize(pendingSize);
+    sending.resize(pendingSize);
+    packet.resize(sizeof(NetworkStream::PacketHeader) + NetworkStream::MAX_PAYLOAD);
+
+    if (settings.protocol == PROTOCOL_UDP) {
+        socket = openSocket(settings.host, settings.port, SOCK_DGRAM, 0);
+        if (socket < 0) {
+            close();
+            return false;
+        }
+    }
+    stopping = false;
+    hasPending = false;
+    frameCount = 0;
+    sender = thread(&NetworkTransport::sendLoop, this);
+    return true;
+}
+
+void NetworkTransport::close()
+{
+    if (sender.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        sender.join();
+    }
+    if (socket >= 0) {
+        ::close(socket);
+        socket = -1;
+    }
+    connected = false;
+    if (compressor) {
+        tjDestroy(compressor);
+        compressor = nullptr;
+    }
+    if (jpeg) {
+        tjFree(jpeg);
+        jpeg = nullptr;
+    }
+}
+
+bool NetworkTransport::hasClients() const
+{
+    return settings.protocol == PROTOCOL_UDP || connected;
+}
+
+void NetworkTransport::publish(const void* pixels, uint64_t sequence, uint64_t timestamp)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (format.pixelFormat == FrameTransportFormat::PIXELS_FLOAT32) {
+            PixelKernels::depthToMillimetres((const float*)pixels, (unsigned short*)pending.data(), format.width * format.height);
+        }
+        else {
+            memcpy(pending.data(), pixels, pending.size());
+        }
+        pendingSequence = sequence;
+        pendingTimestamp = timestamp;
+        pendingFrame = frameCount++;
+        hasPending = true;
+    }
+    changed.notify_one();
+}
+
+std::string NetworkTransport::getName() const
+{
+    return string(settings.protocol == PROTOCOL_UDP ? "udp://" : "tcp://") + settings.host + ":" + ofToString(settings.port);
+}
+
+void NetworkTransport::sendLoop()
+{
+    while (true) {
+        if (settings.protocol == PROTOCOL_TCP && !connected) {
+            connectTcp();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // waking up once a second is how TCP gets reconnected
+            changed.wait_for(lock, std::chrono::seconds(1), [this] { return hasPending || stopping; });
+            if (stopping) {
+                break;
+            }
+            bool sendable = hasPending && hasClients();
+            hasPending = false;
+            if (!sendable) {
+                continue;
+            }
+            sending.swap(pending);
+            header.sequence = pendingSequence;
+            header.timestamp = pendingTimestamp;
+            header.frame = pendingFrame;
+        }
+
+        size_t size = 0;
+        const unsigned char* payload = encode(size);
+        if (!payload) {
+            continue;
+        }
+        if (settings.protocol == PROTOCOL_UDP) {
+            sendUdp(payload, size);
+        }
+        else {
+            sendTcp(payload, size);
+        }
+    }
+    disconnectTcp();
+}
+
+bool NetworkTransport::connectTcp()
+{
+    socket = openSocket(settings.host, settings.port, SOCK_STREAM, 1000);
+    if (socket < 0) {
+        return false;
+    }
+    // frames go out as soon as they are written
+    int one = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    connected = true;
+    return true;
+}
+
+void NetworkTransport::disconnectTcp()
+{
+    if (settings.protocol == PROTOCOL_TCP && socket >= 0) {
+        ::close(socket);
+        socket = -1;
+        connected = false;
+    }
+}
+
+const unsigned char* NetworkTransport::encode(size_t& size)
+{
+    if (header.codec == NetworkStream::CODEC_RVL) {
+        size = DepthCodec::encode((const uint16_t*)sending.data(), format.width * format.height, encoded.data());
+        return encoded.data();
+    }
+    if (header.codec == NetworkStream::CODEC_JPEG) {
+        unsigned long jpegSize = 0;
+        int pixelFormat = format.pixelFormat == FrameTransportFormat::PIXELS_BGRA8 ? TJPF_BGRA : TJPF_RGBA;
+        if (tjCompress2(compressor, sending.data(), format.width, 0, format.height, pixelFormat,
+                        &jpeg, &jpegSize, TJSAMP_420, settings.jpegQuality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC) != 0) {
+            ofLogWarning() << "jpeg encode failed: " << tjGetErrorStr();
+            return nullptr;
+        }
+        size = jpegSize;
+        return jpeg;
+    }
+    size = sending.size();
+    return sending.data();
+}
+
+void NetworkTransport::sendUdp(const unsigned char* payload, size_t size)
+{
+    size_t chunks = max<size_t>(1, (size + NetworkStream::MAX_PAYLOAD - 1) / NetworkStream::MAX_PAYLOAD);
+    if (chunks > 0xffff) {
+        return;
+    }
+    header.frameSize = size;
+    header.chunkCount = chunks;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        size_t offset = chunk * NetworkStream::MAX_PAYLOAD;
+        size_t length = min(NetworkStream::MAX_PAYLOAD, size - offset);
+        header.chunk = chunk;
+        header.chunkOffset = offset;
+        header.payloadSize = length;
+        memcpy(packet.data(), &header, sizeof(header));
+        memcpy(packet.data() + sizeof(header), payload + offset, length);
+        // nothing to be done about a lost datagram, the receiver counts it
+        ::send(socket, packet.data(), sizeof(header) + length, SEND_FLAGS);
+    }
+}
+
+void NetworkTransport::sendTcp(const unsigned char* payload, size_t size)
+{
+    header.frameSize = size;
+    header.chunkCount = 1;
+    header.chunk = 0;
+    header.chunkOffset = 0;
+    header.payloadSize = 0;
+    if (!sendAll(socket, (const unsigned char*)&header, sizeof(header)) || !sendAll(socket, payload, size)) {
+        ofLogNotice() << stream << ": lost the connection to " << getName();
+        disconnectTcp();
+    }
+}
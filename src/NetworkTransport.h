@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ofMain.h"
+#include "turbojpeg.h"
+#include "FrameTransport.h"
+#include "NetworkStream.h"
+#include <condition_variable>
+
+// Sends a stream to another machine, see NetworkStream.h for the wire format
+// and NetworkReceiver for the other end.
+//
+// publish() only copies the frame, depth and IR already converted to 16
+// bit, and a thread of its own encodes and sends it. If that thread is still
+// busy with the previous frame the waiting one is replaced, so a slow link
+// drops frames instead of holding up the app. Depth and IR are RVL coded and
+// colour is JPEG coded unless compression is off; points always go as they
+// are and are better rebuilt on the receiving side from depth.
+//
+// Over UDP frames go to host:port whether anyone listens or not. Over TCP
+// the receiver listens on host:port, the thread connects and reconnects
+// once a second while it can't, and hasClients() is true while connected.
+
+class NetworkTransport : public FrameTransport {
+public:
+    enum Protocol {
+        PROTOCOL_UDP,
+        PROTOCOL_TCP
+    };
+    
+    struct Settings {
+        Protocol protocol = PROTOCOL_UDP;
+        string host = "127.0.0.1";
+        int port = 12340;
+        bool compress = true;
+        int jpegQuality = 80;
+    };
+    
+    explicit NetworkTransport(const Settings& settings);
+    ~NetworkTransport();
+    
+    bool open(const std::string& stream, const FrameFormat& format);
+    void close();
+    bool isOpen() const { return sender.joinable(); }
+    const FrameFormat& getFormat() const { return format; }
+    bool hasClients() const;
+    void publish(const void* pixels, uint64_t sequence, uint64_t timestamp);
+    std::string getName() const;
+
+private:
+    void sendLoop();
+    bool connectTcp();
+    void disconnectTcp();
+    // returns the bytes to send, in sending, encoded or jpeg
+    const unsigned char* encode(size_t& size);
+    void sendUdp(const unsigned char* payload, size_t size);
+    void sendTcp(const unsigned char* payload, size_t size);
+    
+    Settings settings;
+    std::string stream;
+    FrameFormat format;
+    NetworkStream::PacketHeader header;
+    int socket = -1;
+    std::atomic<bool> connected { false };
+    
+    // the newest frame, waiting for the thread. Swapped with sending when
+    // the thread takes it
+    vector<unsigned char> pending;
+    uint64_t pendingSequence = 0;
+    uint64_t pendingTimestamp = 0;
+    uint32_t pendingFrame = 0;
+    bool hasPending = false;
+    uint32_t frameCount = 0;
+    
+    vector<unsigned char> sending;
+    vector<unsigned char> encoded;
+    vector<unsigned char> packet;
+    tjhandle compressor = nullptr;
+    unsigned char* jpeg = nullptr;
+    
+    thread sender;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
@@ -0,0 +1,753 @@
+#include "PixelKernels.h"
+#include "DepthCodec.h"
+#include "DepthMapping.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define PIXELKERNELS_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define PIXELKERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(PIXELKERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PIXELKERNELS_AVX2
+#define PIXELKERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+    const float DEPTH_LOW1 = 500.0f;
+    const float DEPTH_HIGH1 = 5000.0f;
+    const float DEPTH_LOW2 = 1.0f;
+    const float DEPTH_HIGH2 = 0.0f;
+    const float IR_MAX = 65535.0f;
+
+    //--------------------------------------------------------------
+    // scalar, the reference every other instruction set has to match
+
+    // NaN clamps to 0, the same as maxps/minps with the constant second
+    inline float clampUnit(float value) {
+        value = value > 0.0f ? value : 0.0f;
+        return value < 1.0f ? value : 1.0f;
+    }
+
+    // same operation order as the GLSL so the results round identically
+    inline float depthToUnit(float value) {
+        float d = clampUnit(DEPTH_LOW2 + (value - DEPTH_LOW1) * (DEPTH_HIGH2 - DEPTH_LOW2) / (DEPTH_HIGH1 - DEPTH_LOW1));
+        return d == 1.0f ? 0.0f : d;
+    }
+
+    inline float irToUnit(float value) {
+        return clampUnit(value / IR_MAX);
+    }
+
+    // float -> unorm8 as done by GL when writing to an RGBA8 target, round to
+    // nearest even so no multiply-add can be fused differently per compiler
+    inline unsigned char unitToByte(float value) {
+        return (unsigned char)lrintf(value * 255.0f);
+    }
+
+    void depthToGreyScalar(const float* depth, unsigned char* grey, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            grey[i] = unitToByte(depthToUnit(depth[i]));
+        }
+    }
+
+    void depthToUnitScalar(const float* depth, float* unit, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            unit[i] = depthToUnit(depth[i]);
+        }
+    }
+
+    void irToGreyScalar(const float* ir, unsigned char* grey, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            grey[i] = unitToByte(irToUnit(ir[i]));
+        }
+    }
+
+    void irToUnitScalar(const float* ir, float* unit, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            unit[i] = irToUnit(ir[i]);
+        }
+    }
+
+    inline int lookupIndex(float value) {
+        if (value >= 0.0f && value < 65536.0f) {
+            return (int)value;
+        }
+        return value >= 65536.0f ? 65535 : 0;
+    }
+
+    void lookupGreyScalar(const float* depth, const unsigned char* table, unsigned char* grey, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            grey[i] = table[lookupIndex(depth[i])];
+        }
+    }
+
+    void lookupUnitScalar(const float* depth, const float* table, float* unit, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            unit[i] = table[lookupIndex(depth[i])];
+        }
+    }
+
+    void depthToMillimetresScalar(const float* depth, unsigned short* millimetres, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            millimetres[i] = (unsigned short)lookupIndex(depth[i]);
+        }
+    }
+
+    // R = high byte, G = low byte, B = 0, A = 255 as one little endian word
+    inline unsigned int packMillimetres(unsigned int mm) {
+        return (mm >> 8) | ((mm & 0xff) << 8) | 0xff000000;
+    }
+
+    void packDepth16Scalar(const float* depth, unsigned char* rgba, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            unsigned int word = packMillimetres(lookupIndex(depth[i]));
+            memcpy(rgba + i * 4, &word, 4);
+        }
+    }
+
+    //--------------------------------------------------------------
+    // SSE2, always available on x86-64. There is no gather so the table
+    // lookups stay scalar.
+
+#ifdef PIXELKERNELS_X86
+    inline __m128 clampUnitSSE2(__m128 value) {
+        return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    }
+
+    inline __m128 depthToUnitSSE2(__m128 value) {
+        __m128 d = _mm_sub_ps(value, _mm_set1_ps(DEPTH_LOW1));
+        d = _mm_mul_ps(d, _mm_set1_ps(DEPTH_HIGH2 - DEPTH_LOW2));
+        d = _mm_div_ps(d, _mm_set1_ps(DEPTH_HIGH1 - DEPTH_LOW1));
+        d = clampUnitSSE2(_mm_add_ps(_mm_set1_ps(DEPTH_LOW2), d));
+        return _mm_andnot_ps(_mm_cmpeq_ps(d, _mm_set1_ps(1.0f)), d);
+    }
+
+    inline __m128 irToUnitSSE2(__m128 value) {
+        return clampUnitSSE2(_mm_div_ps(value, _mm_set1_ps(IR_MAX)));
+    }
+
+    // 16 units to 16 bytes, cvtps rounds to nearest even like lrintf
+    inline __m128i unitToByteSSE2(__m128 a, __m128 b, __m128 c, __m128 d) {
+        const __m128 scale = _mm_set1_ps(255.0f);
+        __m128i ab = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, scale)), _mm_cvtps_epi32(_mm_mul_ps(b, scale)));
+        __m128i cd = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(c, scale)), _mm_cvtps_epi32(_mm_mul_ps(d, scale)));
+        return _mm_packus_epi16(ab, cd);
+    }
+
+    inline __m128i lookupIndexSSE2(__m128 value) {
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+        return _mm_cvttps_epi32(value);
+    }
+
+    inline __m128i packMillimetresSSE2(__m128i mm) {
+        __m128i high = _mm_srli_epi32(mm, 8);
+        __m128i low = _mm_slli_epi32(_mm_and_si128(mm, _mm_set1_epi32(0xff)), 8);
+        return _mm_or_si128(_mm_or_si128(high, low), _mm_set1_epi32((int)0xff000000));
+    }
+
+    // no unsigned 32 -> 16 pack in SSE2, so bias into signed range and back
+    void depthToMillimetresSSE2(const float* depth, unsigned short* millimetres, size_t count) {
+        const __m128i bias32 = _mm_set1_epi32(32768);
+        const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_sub_epi32(lookupIndexSSE2(_mm_loadu_ps(depth + i)), bias32);
+            __m128i b = _mm_sub_epi32(lookupIndexSSE2(_mm_loadu_ps(depth + i + 4)), bias32);
+            _mm_storeu_si128((__m128i*)(millimetres + i), _mm_add_epi16(_mm_packs_epi32(a, b), bias16));
+        }
+        depthToMillimetresScalar(depth + i, millimetres + i, count - i);
+    }
+
+    void packDepth16SSE2(const float* depth, unsigned char* rgba, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_si128((__m128i*)(rgba + i * 4), packMillimetresSSE2(lookupIndexSSE2(_mm_loadu_ps(depth + i))));
+        }
+        packDepth16Scalar(depth + i, rgba + i * 4, count - i);
+    }
+
+    void depthToGreySSE2(const float* depth, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i bytes = unitToByteSSE2(depthToUnitSSE2(_mm_loadu_ps(depth + i)),
+                                           depthToUnitSSE2(_mm_loadu_ps(depth + i + 4)),
+                                           depthToUnitSSE2(_mm_loadu_ps(depth + i + 8)),
+                                           depthToUnitSSE2(_mm_loadu_ps(depth + i + 12)));
+            _mm_storeu_si128((__m128i*)(grey + i), bytes);
+        }
+        depthToGreyScalar(depth + i, grey + i, count - i);
+    }
+
+    void depthToUnitSSE2(const float* depth, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(unit + i, depthToUnitSSE2(_mm_loadu_ps(depth + i)));
+        }
+        depthToUnitScalar(depth + i, unit + i, count - i);
+    }
+
+    void irToGreySSE2(const float* ir, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i bytes = unitToByteSSE2(irToUnitSSE2(_mm_loadu_ps(ir + i)),
+                                           irToUnitSSE2(_mm_loadu_ps(ir + i + 4)),
+                                           irToUnitSSE2(_mm_loadu_ps(ir + i + 8)),
+                                           irToUnitSSE2(_mm_loadu_ps(ir + i + 12)));
+            _mm_storeu_si128((__m128i*)(grey + i), bytes);
+        }
+        irToGreyScalar(ir + i, grey + i, count - i);
+    }
+
+    void irToUnitSSE2(const float* ir, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(unit + i, irToUnitSSE2(_mm_loadu_ps(ir + i)));
+        }
+        irToUnitScalar(ir + i, unit + i, count - i);
+    }
+#endif
+
+    //--------------------------------------------------------------
+    // AVX2, compiled for the target here and only called after a cpuid check
+
+#ifdef PIXELKERNELS_AVX2
+    PIXELKERNELS_TARGET_AVX2 inline __m256 clampUnitAVX2(__m256 value) {
+        return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    }
+
+    PIXELKERNELS_TARGET_AVX2 inline __m256 depthToUnitAVX2(__m256 value) {
+        __m256 d = _mm256_sub_ps(value, _mm256_set1_ps(DEPTH_LOW1));
+        d = _mm256_mul_ps(d, _mm256_set1_ps(DEPTH_HIGH2 - DEPTH_LOW2));
+        d = _mm256_div_ps(d, _mm256_set1_ps(DEPTH_HIGH1 - DEPTH_LOW1));
+        d = clampUnitAVX2(_mm256_add_ps(_mm256_set1_ps(DEPTH_LOW2), d));
+        return _mm256_andnot_ps(_mm256_cmp_ps(d, _mm256_set1_ps(1.0f), _CMP_EQ_OQ), d);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 inline __m256 irToUnitAVX2(__m256 value) {
+        return clampUnitAVX2(_mm256_div_ps(value, _mm256_set1_ps(IR_MAX)));
+    }
+
+    // 32 units to 32 bytes, the packs work per 128 bit lane so fix the order after
+    PIXELKERNELS_TARGET_AVX2 inline __m256i unitToByteAVX2(__m256 a, __m256 b, __m256 c, __m256 d) {
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        __m256i ab = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(a, scale)), _mm256_cvtps_epi32(_mm256_mul_ps(b, scale)));
+        __m256i cd = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(c, scale)), _mm256_cvtps_epi32(_mm256_mul_ps(d, scale)));
+        __m256i bytes = _mm256_packus_epi16(ab, cd);
+        return _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    }
+
+    // NaN goes to 0 through max, then truncate like lookupIndex
+    PIXELKERNELS_TARGET_AVX2 inline __m256i lookupIndexAVX2(__m256 value) {
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(65535.0f));
+        return _mm256_cvttps_epi32(value);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 inline __m256i gatherByteAVX2(const unsigned char* table, __m256 value) {
+        __m256i words = _mm256_i32gather_epi32((const int*)table, lookupIndexAVX2(value), 1);
+        return _mm256_and_si256(words, _mm256_set1_epi32(0xff));
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void lookupGreyAVX2(const float* depth, const unsigned char* table, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i ab = _mm256_packs_epi32(gatherByteAVX2(table, _mm256_loadu_ps(depth + i)), gatherByteAVX2(table, _mm256_loadu_ps(depth + i + 8)));
+            __m256i cd = _mm256_packs_epi32(gatherByteAVX2(table, _mm256_loadu_ps(depth + i + 16)), gatherByteAVX2(table, _mm256_loadu_ps(depth + i + 24)));
+            __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+            _mm256_storeu_si256((__m256i*)(grey + i), bytes);
+        }
+        lookupGreyScalar(depth + i, table, grey + i, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void lookupUnitAVX2(const float* depth, const float* table, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_ps(unit + i, _mm256_i32gather_ps(table, lookupIndexAVX2(_mm256_loadu_ps(depth + i)), 4));
+        }
+        lookupUnitScalar(depth + i, table, unit + i, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void depthToMillimetresAVX2(const float* depth, unsigned short* millimetres, size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m256i packed = _mm256_packus_epi32(lookupIndexAVX2(_mm256_loadu_ps(depth + i)), lookupIndexAVX2(_mm256_loadu_ps(depth + i + 8)));
+            _mm256_storeu_si256((__m256i*)(millimetres + i), _mm256_permute4x64_epi64(packed, 0xd8));
+        }
+        depthToMillimetresScalar(depth + i, millimetres + i, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void packDepth16AVX2(const float* depth, unsigned char* rgba, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i mm = lookupIndexAVX2(_mm256_loadu_ps(depth + i));
+            __m256i high = _mm256_srli_epi32(mm, 8);
+            __m256i low = _mm256_slli_epi32(_mm256_and_si256(mm, _mm256_set1_epi32(0xff)), 8);
+            __m256i word = _mm256_or_si256(_mm256_or_si256(high, low), _mm256_set1_epi32((int)0xff000000));
+            _mm256_storeu_si256((__m256i*)(rgba + i * 4), word);
+        }
+        packDepth16Scalar(depth + i, rgba + i * 4, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void depthToGreyAVX2(const float* depth, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i bytes = unitToByteAVX2(depthToUnitAVX2(_mm256_loadu_ps(depth + i)),
+                                           depthToUnitAVX2(_mm256_loadu_ps(depth + i + 8)),
+                                           depthToUnitAVX2(_mm256_loadu_ps(depth + i + 16)),
+                                           depthToUnitAVX2(_mm256_loadu_ps(depth + i + 24)));
+            _mm256_storeu_si256((__m256i*)(grey + i), bytes);
+        }
+        depthToGreyScalar(depth + i, grey + i, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void depthToUnitAVX2(const float* depth, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_ps(unit + i, depthToUnitAVX2(_mm256_loadu_ps(depth + i)));
+        }
+        depthToUnitScalar(depth + i, unit + i, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void irToGreyAVX2(const float* ir, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i bytes = unitToByteAVX2(irToUnitAVX2(_mm256_loadu_ps(ir + i)),
+                                           irToUnitAVX2(_mm256_loadu_ps(ir + i + 8)),
+                                           irToUnitAVX2(_mm256_loadu_ps(ir + i + 16)),
+                                           irToUnitAVX2(_mm256_loadu_ps(ir + i + 24)));
+            _mm256_storeu_si256((__m256i*)(grey + i), bytes);
+        }
+        irToGreyScalar(ir + i, grey + i, count - i);
+    }
+
+    PIXELKERNELS_TARGET_AVX2 void irToUnitAVX2(const float* ir, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_ps(unit + i, irToUnitAVX2(_mm256_loadu_ps(ir + i)));
+        }
+        irToUnitScalar(ir + i, unit + i, count - i);
+    }
+#endif
+
+    //--------------------------------------------------------------
+    // NEON, AArch64 only since it needs vdivq and the round to nearest convert.
+    // Like SSE2 there is no gather, the table lookups stay scalar.
+
+#ifdef PIXELKERNELS_NEON
+    // maxnm/minnm return the number when one side is NaN, like the scalar clamp
+    inline float32x4_t clampUnitNEON(float32x4_t value) {
+        return vminnmq_f32(vmaxnmq_f32(value, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    }
+
+    inline float32x4_t depthToUnitNEON(float32x4_t value) {
+        float32x4_t d = vsubq_f32(value, vdupq_n_f32(DEPTH_LOW1));
+        d = vmulq_f32(d, vdupq_n_f32(DEPTH_HIGH2 - DEPTH_LOW2));
+        d = vdivq_f32(d, vdupq_n_f32(DEPTH_HIGH1 - DEPTH_LOW1));
+        d = clampUnitNEON(vaddq_f32(vdupq_n_f32(DEPTH_LOW2), d));
+        uint32x4_t one = vceqq_f32(d, vdupq_n_f32(1.0f));
+        return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(d), one));
+    }
+
+    inline float32x4_t irToUnitNEON(float32x4_t value) {
+        return clampUnitNEON(vdivq_f32(value, vdupq_n_f32(IR_MAX)));
+    }
+
+    inline uint8x16_t unitToByteNEON(float32x4_t a, float32x4_t b, float32x4_t c, float32x4_t d) {
+        const float32x4_t scale = vdupq_n_f32(255.0f);
+        int16x8_t ab = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(a, scale))), vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(b, scale))));
+        int16x8_t cd = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(c, scale))), vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(d, scale))));
+        return vcombine_u8(vqmovun_s16(ab), vqmovun_s16(cd));
+    }
+
+    // maxnm sends NaN to 0, the convert truncates like lookupIndex
+    inline uint32x4_t lookupIndexNEON(float32x4_t value) {
+        value = vminnmq_f32(vmaxnmq_f32(value, vdupq_n_f32(0.0f)), vdupq_n_f32(65535.0f));
+        return vcvtq_u32_f32(value);
+    }
+
+    void depthToMillimetresNEON(const float* depth, unsigned short* millimetres, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            uint16x8_t mm = vcombine_u16(vmovn_u32(lookupIndexNEON(vld1q_f32(depth + i))), vmovn_u32(lookupIndexNEON(vld1q_f32(depth + i + 4))));
+            vst1q_u16(millimetres + i, mm);
+        }
+        depthToMillimetresScalar(depth + i, millimetres + i, count - i);
+    }
+
+    void packDepth16NEON(const float* depth, unsigned char* rgba, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t mm = lookupIndexNEON(vld1q_f32(depth + i));
+            uint32x4_t high = vshrq_n_u32(mm, 8);
+            uint32x4_t low = vshlq_n_u32(vandq_u32(mm, vdupq_n_u32(0xff)), 8);
+            uint32x4_t word = vorrq_u32(vorrq_u32(high, low), vdupq_n_u32(0xff000000));
+            vst1q_u8(rgba + i * 4, vreinterpretq_u8_u32(word));
+        }
+        packDepth16Scalar(depth + i, rgba + i * 4, count - i);
+    }
+
+    void depthToGreyNEON(const float* depth, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            vst1q_u8(grey + i, unitToByteNEON(depthToUnitNEON(vld1q_f32(depth + i)),
+                                              depthToUnitNEON(vld1q_f32(depth + i + 4)),
+                                              depthToUnitNEON(vld1q_f32(depth + i + 8)),
+                                              depthToUnitNEON(vld1q_f32(depth + i + 12))));
+        }
+        depthToGreyScalar(depth + i, grey + i, count - i);
+    }
+
+    void depthToUnitNEON(const float* depth, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            vst1q_f32(unit + i, depthToUnitNEON(vld1q_f32(depth + i)));
+        }
+        depthToUnitScalar(depth + i, unit + i, count - i);
+    }
+
+    void irToGreyNEON(const float* ir, unsigned char* grey, size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            vst1q_u8(grey + i, unitToByteNEON(irToUnitNEON(vld1q_f32(ir + i)),
+                                              irToUnitNEON(vld1q_f32(ir + i + 4)),
+                                              irToUnitNEON(vld1q_f32(ir + i + 8)),
+                                              irToUnitNEON(vld1q_f32(ir + i + 12))));
+        }
+        irToGreyScalar(ir + i, grey + i, count - i);
+    }
+
+    void irToUnitNEON(const float* ir, float* unit, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            vst1q_f32(unit + i, irToUnitNEON(vld1q_f32(ir + i)));
+        }
+        irToUnitScalar(ir + i, unit + i, count - i);
+    }
+#endif
+
+    //--------------------------------------------------------------
+    // dispatch
+
+    struct Kernels {
+        void (*depthToGrey)(const float*, unsigned char*, size_t);
+        void (*depthToUnit)(const float*, float*, size_t);
+        void (*irToGrey)(const float*, unsigned char*, size_t);
+        void (*irToUnit)(const float*, float*, size_t);
+        void (*lookupGrey)(const float*, const unsigned char*, unsigned char*, size_t);
+        void (*lookupUnit)(const float*, const float*, float*, size_t);
+        void (*depthToMillimetres)(const float*, unsigned short*, size_t);
+        void (*packDepth16)(const float*, unsigned char*, size_t);
+    };
+
+    const Kernels scalarKernels = { depthToGreyScalar, depthToUnitScalar, irToGreyScalar, irToUnitScalar, lookupGreyScalar, lookupUnitScalar, depthToMillimetresScalar, packDepth16Scalar };
+
+    Kernels getKernels(PixelKernels::Isa isa) {
+        switch (isa) {
+#ifdef PIXELKERNELS_X86
+            case PixelKernels::ISA_SSE2: {
+                Kernels kernels = { depthToGreySSE2, depthToUnitSSE2, irToGreySSE2, irToUnitSSE2, lookupGreyScalar, lookupUnitScalar, depthToMillimetresSSE2, packDepth16SSE2 };
+                return kernels;
+            }
+#endif
+#ifdef PIXELKERNELS_AVX2
+            case PixelKernels::ISA_AVX2: {
+                Kernels kernels = { depthToGreyAVX2, depthToUnitAVX2, irToGreyAVX2, irToUnitAVX2, lookupGreyAVX2, lookupUnitAVX2, depthToMillimetresAVX2, packDepth16AVX2 };
+                return kernels;
+            }
+#endif
+#ifdef PIXELKERNELS_NEON
+            case PixelKernels::ISA_NEON: {
+                Kernels kernels = { depthToGreyNEON, depthToUnitNEON, irToGreyNEON, irToUnitNEON, lookupGreyScalar, lookupUnitScalar, depthToMillimetresNEON, packDepth16NEON };
+                return kernels;
+            }
+#endif
+            default:
+                return scalarKernels;
+        }
+    }
+
+    PixelKernels::Isa currentIsa = PixelKernels::getBestIsa();
+    Kernels current = getKernels(currentIsa);
+
+}
+
+bool PixelKernels::isSupported(Isa isa)
+{
+    switch (isa) {
+        case ISA_SCALAR:
+            return true;
+#ifdef PIXELKERNELS_X86
+        case ISA_SSE2:
+            return true;
+#endif
+#ifdef PIXELKERNELS_AVX2
+        case ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef PIXELKERNELS_NEON
+        case ISA_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+PixelKernels::Isa PixelKernels::getBestIsa()
+{
+    for (int isa = ISA_COUNT - 1; isa > ISA_SCALAR; isa--) {
+        if (isSupported((Isa)isa)) {
+            return (Isa)isa;
+        }
+    }
+    return ISA_SCALAR;
+}
+
+void PixelKernels::setIsa(Isa isa)
+{
+    currentIsa = isSupported(isa) ? isa : ISA_SCALAR;
+    current = getKernels(currentIsa);
+}
+
+PixelKernels::Isa PixelKernels::getIsa()
+{
+    return currentIsa;
+}
+
+std::string PixelKernels::getIsaName(Isa isa)
+{
+    switch (isa) {
+        case ISA_SSE2: return "sse2";
+        case ISA_AVX2: return "avx2";
+        case ISA_NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+bool PixelKernels::parseIsa(const std::string& name, Isa& isa)
+{
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "auto") {
+        isa = getBestIsa();
+        return true;
+    }
+    for (int i = 0; i < ISA_COUNT; i++) {
+        if (lower == getIsaName((Isa)i)) {
+            isa = (Isa)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PixelKernels::depthToGrey(const float* depth, unsigned char* grey, size_t count)
+{
+    current.depthToGrey(depth, grey, count);
+}
+
+void PixelKernels::depthToUnit(const float* depth, float* unit, size_t count)
+{
+    current.depthToUnit(depth, unit, count);
+}
+
+void PixelKernels::irToGrey(const float* ir, unsigned char* grey, size_t count)
+{
+    current.irToGrey(ir, grey, count);
+}
+
+void PixelKernels::irToUnit(const float* ir, float* unit, size_t count)
+{
+    current.irToUnit(ir, unit, count);
+}
+
+void PixelKernels::lookupGrey(const float* depth, const unsigned char* table, unsigned char* grey, size_t count)
+{
+    current.lookupGrey(depth, table, grey, count);
+}
+
+void PixelKernels::lookupUnit(const float* depth, const float* table, float* unit, size_t count)
+{
+    current.lookupUnit(depth, table, unit, count);
+}
+
+void PixelKernels::depthToMillimetres(const float* depth, unsigned short* millimetres, size_t count)
+{
+    current.depthToMillimetres(depth, millimetres, count);
+}
+
+void PixelKernels::packDepth16(const float* depth, unsigned char* rgba, size_t count)
+{
+    current.packDepth16(depth, rgba, count);
+}
+
+//--------------------------------------------------------------
+namespace {
+
+    // every integer millimetre a Kinect can report, the clip edges and their
+    // float neighbours, plus values the device never sends but a file might
+    std::vector<float> makeGoldenInput() {
+        std::vector<float> input;
+        for (int i = 0; i <= 65535; i++) {
+            input.push_back((float)i);
+        }
+        const float edges[] = { DEPTH_LOW1, DEPTH_HIGH1, IR_MAX, 2750.0f };
+        for (float edge : edges) {
+            input.push_back(std::nextafter(edge, 0.0f));
+            input.push_back(std::nextafter(edge, 1e9f));
+            input.push_back(edge + 0.5f);
+        }
+        input.push_back(-1.0f);
+        input.push_back(1e9f);
+        input.push_back(NAN);
+        input.push_back(INFINITY);
+        input.push_back(-INFINITY);
+        // odd length so every tail path runs too
+        if (input.size() % 2 == 0) {
+            input.push_back(1234.5f);
+        }
+        return input;
+    }
+
+    struct GoldenValue {
+        float input;
+        unsigned char depthGrey;
+        unsigned char irGrey;
+    };
+
+    // hand checked against the shader math
+    const GoldenValue goldenValues[] = {
+        { 0.0f,     0,   0 },   // no data
+        { 500.0f,   0,   2 },   // near clip maps to 1 and is zeroed
+        { 501.0f,   255, 2 },
+        { 2750.0f,  128, 11 },  // 0.5 exactly, 127.5 rounds to even
+        { 5000.0f,  0,   19 },  // far clip
+        { 8000.0f,  0,   31 },
+        { 65535.0f, 0,   255 },
+    };
+
+}
+
+bool PixelKernels::verify(std::string& report)
+{
+    std::ostringstream out;
+    bool ok = true;
+
+    std::vector<float> input = makeGoldenInput();
+    size_t count = input.size();
+
+    std::vector<unsigned char> referenceDepthGrey(count), referenceIrGrey(count);
+    std::vector<float> referenceDepthUnit(count), referenceIrUnit(count);
+    depthToGreyScalar(input.data(), referenceDepthGrey.data(), count);
+    depthToUnitScalar(input.data(), referenceDepthUnit.data(), count);
+    irToGreyScalar(input.data(), referenceIrGrey.data(), count);
+    irToUnitScalar(input.data(), referenceIrUnit.data(), count);
+
+    // a table with a different value in every entry catches wrong indices
+    std::vector<unsigned char> greyTable(65536 + 3);
+    std::vector<float> unitTable(65536);
+    for (int i = 0; i < 65536; i++) {
+        greyTable[i] = (unsigned char)(i * 7 + (i >> 8));
+        unitTable[i] = i / 65535.0f;
+    }
+    std::vector<unsigned char> referenceLookupGrey(count);
+    std::vector<float> referenceLookupUnit(count);
+    lookupGreyScalar(input.data(), greyTable.data(), referenceLookupGrey.data(), count);
+    lookupUnitScalar(input.data(), unitTable.data(), referenceLookupUnit.data(), count);
+    std::vector<unsigned short> referenceMillimetres(count);
+    std::vector<unsigned char> referencePacked(count * 4);
+    depthToMillimetresScalar(input.data(), referenceMillimetres.data(), count);
+    packDepth16Scalar(input.data(), referencePacked.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        if (referenceMillimetres[i] != referencePacked[i * 4] * 256 + referencePacked[i * 4 + 1]) {
+            out << "packed raw depth does not decode to " << referenceMillimetres[i] << "\n";
+            ok = false;
+            break;
+        }
+    }
+
+    for (const GoldenValue& golden : goldenValues) {
+        size_t index = (size_t)golden.input;
+        if (referenceDepthGrey[index] != golden.depthGrey || referenceIrGrey[index] != golden.irGrey) {
+            out << "golden value " << golden.input << " gave depth " << (int)referenceDepthGrey[index]
+                << " ir " << (int)referenceIrGrey[index] << ", expected " << (int)golden.depthGrey
+                << " " << (int)golden.irGrey << "\n";
+            ok = false;
+        }
+    }
+
+    // the default mapping stands in for the original shader, which only
+    // ever sees whole millimetres
+    DepthMapping mapping;
+    mapping.update();
+    for (int i = 0; i < DepthMapping::TABLE_SIZE; i++) {
+        float unit = mapping.getUnitTable()[i];
+        if (mapping.getGreyTable()[i] != referenceDepthGrey[i] || memcmp(&unit, &referenceDepthUnit[i], sizeof(float)) != 0) {
+            out << "default depth mapping differs from the shader at " << i << " mm\n";
+            ok = false;
+            break;
+        }
+    }
+
+    // RVL round trips the millimetres, including runs longer than one code
+    // holds, like an empty height map of a large floor
+    std::vector<uint16_t> rvlInput(referenceMillimetres);
+    rvlInput.resize(rvlInput.size() + (3 << 21), 0);
+    rvlInput.resize(rvlInput.size() + (3 << 21), 1000);
+    std::vector<unsigned char> rvl(DepthCodec::getMaxEncodedSize(rvlInput.size()));
+    std::vector<uint16_t> rvlOutput(rvlInput.size());
+    size_t rvlSize = DepthCodec::encode(rvlInput.data(), rvlInput.size(), rvl.data());
+    if (!DepthCodec::decode(rvl.data(), rvlSize, rvlOutput.data(), rvlOutput.size()) || rvlOutput != rvlInput) {
+        out << "RVL does not round trip\n";
+        ok = false;
+    }
+
+    for (int i = 0; i < ISA_COUNT; i++) {
+        Isa isa = (Isa)i;
+        if (!isSupported(isa)) {
+            out << getIsaName(isa) << ": not supported\n";
+            continue;
+        }
+
+        Kernels kernels = getKernels(isa);
+        std::vector<unsigned char> depthGrey(count), irGrey(count);
+        std::vector<float> depthUnit(count), irUnit(count);
+        kernels.depthToGrey(input.data(), depthGrey.data(), count);
+        kernels.depthToUnit(input.data(), depthUnit.data(), count);
+        kernels.irToGrey(input.data(), irGrey.data(), count);
+        kernels.irToUnit(input.data(), irUnit.data(), count);
+        std::vector<unsigned char> lookupGrey(count);
+        std::vector<float> lookupUnit(count);
+        kernels.lookupGrey(input.data(), greyTable.data(), lookupGrey.data(), count);
+        kernels.lookupUnit(input.data(), unitTable.data(), lookupUnit.data(), count);
+        std::vector<unsigned short> millimetres(count);
+        std::vector<unsigned char> packed(count * 4);
+        kernels.depthToMillimetres(input.data(), millimetres.data(), count);
+        kernels.packDepth16(input.data(), packed.data(), count);
+
+        // compare the float bits, not the values, so -0 and 0 count as different
+        bool match = depthGrey == referenceDepthGrey && irGrey == referenceIrGrey
+            && std::equal(depthUnit.begin(), depthUnit.end(), referenceDepthUnit.begin(), [](float a, float b) { return memcmp(&a, &b, sizeof(float)) == 0; })
+            && std::equal(irUnit.begin(), irUnit.end(), referenceIrUnit.begin(), [](float a, float b) { return memcmp(&a, &b, sizeof(float)) == 0; })
+            && lookupGrey == referenceLookupGrey && lookupUnit == referenceLookupUnit
+            && millimetres == referenceMillimetres && packed == referencePacked;
+        out << getIsaName(isa) << ": " << (match ? "ok" : "MISMATCH") << "\n";
+        ok = ok && match;
+    }
+
+    report = out.str();
+    return ok;
+}
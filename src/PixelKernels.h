@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// CPU versions of the depth and IR fragment shaders in ofApp.cpp, used when
+// there is no GL context to run them on or when CPU_CONVERSION is set.
+// Outputs are single channel. The 8-bit variants match what the shaders write
+// into the RGBA8 fbos, the float variants match the shader value before the
+// write. Every instruction set produces bit-identical results.
+
+namespace PixelKernels {
+
+    enum Isa {
+        ISA_SCALAR,
+        ISA_SSE2,
+        ISA_AVX2,
+        ISA_NEON,
+        ISA_COUNT
+    };
+
+    bool isSupported(Isa isa);
+    Isa getBestIsa();
+
+    // selects the kernels used by the functions below, falls back to scalar
+    // if the requested set is not supported on this machine
+    void setIsa(Isa isa);
+    Isa getIsa();
+
+    std::string getIsaName(Isa isa);
+    // accepts "auto" or one of the names above, case insensitive
+    bool parseIsa(const std::string& name, Isa& isa);
+
+    // the original fixed depth shader: 500..5000 mm remapped to 1..0, near
+    // values zeroed. DepthMapping's default table reproduces it exactly.
+    void depthToGrey(const float* depth, unsigned char* grey, size_t count);
+    void depthToUnit(const float* depth, float* unit, size_t count);
+
+    // irFragmentShader: raw IR / 65535
+    void irToGrey(const float* ir, unsigned char* grey, size_t count);
+    void irToUnit(const float* ir, float* unit, size_t count);
+
+    // depth in millimetres through a 65536 entry table indexed by the
+    // truncated value, see DepthMapping. The byte table needs 3 bytes of
+    // padding after the last entry for the gather versions.
+    void lookupGrey(const float* depth, const unsigned char* table, unsigned char* grey, size_t count);
+    void lookupUnit(const float* depth, const float* table, float* unit, size_t count);
+
+    // raw depth for the raw depth output, millimetres truncated and clamped
+    // to 0..65535 like the table lookups. The packed version writes RGBA8 with
+    // the high byte in R and the low byte in G, so it survives an 8-bit
+    // texture path: mm = R * 256 + G.
+    void depthToMillimetres(const float* depth, unsigned short* millimetres, size_t count);
+    void packDepth16(const float* depth, unsigned char* rgba, size_t count);
+
+    // Runs every supported instruction set over a golden set of inputs and
+    // compares against the shader math, known output values and the scalar
+    // table lookups. Returns false on a mismatch, report receives a line per
+    // kernel.
+    bool verify(std::string& report);
+
+}
@@ -0,0 +1,76 @@
+#include "PointCloud.h"
+
+#include <algorithm>
+#include <cmath>
+
+void PointCloud::setup(int width, int height, const Intrinsics& intrinsics)
+{
+    this->width = width;
+    this->height = height;
+    this->intrinsics = intrinsics;
+    rays.resize(width * height * 2);
+    
+    const Intrinsics& k = intrinsics;
+    for (int v = 0; v < height; v++) {
+        for (int u = 0; u < width; u++) {
+            // distorted normalised coordinates, then undo the distortion by
+            // fixed point iteration, which converges in a few steps for the
+            // mild distortion of the Kinect lens
+            float xd = (u - k.cx) / k.fx;
+            float yd = (v - k.cy) / k.fy;
+            float x = xd;
+            float y = yd;
+            for (int i = 0; i < 20; i++) {
+                float r2 = x * x + y * y;
+                float radial = 1 + r2 * (k.k1 + r2 * (k.k2 + r2 * k.k3));
+                float dx = 2 * k.p1 * x * y + k.p2 * (r2 + 2 * x * x);
+                float dy = k.p1 * (r2 + 2 * y * y) + 2 * k.p2 * x * y;
+                x = (xd - dx) / radial;
+                y = (yd - dy) / radial;
+            }
+            float* ray = &rays[(v * width + u) * 2];
+            ray[0] = x * 0.001f;
+            // image rows go down, y goes up
+            ray[1] = -y * 0.001f;
+        }
+    }
+}
+
+void PointCloud::getRay(int x, int y, float& rayX, float& rayY) const
+{
+    const float* ray = &rays[(y * width + x) * 2];
+    rayX = ray[0];
+    rayY = ray[1];
+}
+
+void PointCloud::unproject(const float* depth, float* xyz) const
+{
+    size_t count = width * height;
+    const float* ray = rays.data();
+    for (size_t i = 0; i < count; i++) {
+        float d = depth[i];
+        xyz[i * 3] = ray[i * 2] * d;
+        xyz[i * 3 + 1] = ray[i * 2 + 1] * d;
+        xyz[i * 3 + 2] = d * 0.001f;
+    }
+}
+
+void PointCloud::pack16(const float* xyz, unsigned char* rgba, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        unsigned short mm[3];
+        for (int c = 0; c < 3; c++) {
+            float value = std::min(std::max(xyz[i * 3 + c] * 1000.0f, -32768.0f), 32767.0f);
+            mm[c] = (unsigned short)(short)lrintf(value);
+        }
+        unsigned char* out = rgba + i * 8;
+        out[0] = mm[0] >> 8;
+        out[1] = mm[0] & 0xff;
+        out[2] = mm[1] >> 8;
+        out[3] = 255;
+        out[4] = mm[1] & 0xff;
+        out[5] = mm[2] >> 8;
+        out[6] = mm[2] & 0xff;
+        out[7] = 255;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Depth to camera space points.
+//
+// The unprojection ray of every pixel, lens distortion removed, is worked out
+// once in setup() and stored with the mm to metres scale folded in, so a frame
+// costs one multiply per component: x = rayX * d, y = rayY * d, z = d / 1000.
+// Points are in metres, x to the right, y up and z away from the sensor.
+// Pixels without depth come out as 0, 0, 0.
+
+class PointCloud {
+public:
+    // pinhole model with Brown-Conrady distortion, in pixels of the depth image
+    struct Intrinsics {
+        // Kinect v2 depth camera, typical factory values
+        float fx = 365.456f;
+        float fy = 365.456f;
+        float cx = 254.878f;
+        float cy = 205.395f;
+        float k1 = 0.0905474f;
+        float k2 = -0.26819f;
+        float k3 = 0.0950862f;
+        float p1 = 0.0f;
+        float p2 = 0.0f;
+    };
+    
+    void setup(int width, int height, const Intrinsics& intrinsics);
+    const Intrinsics& getIntrinsics() const { return intrinsics; }
+    
+    // depth in mm, xyz receives 3 floats per pixel
+    void unproject(const float* depth, float* xyz) const;
+    
+    // the points as int16 mm over two RGBA8 pixels each, for 8-bit outputs:
+    // (x hi, x lo, y hi, 255) (y lo, z hi, z lo, 255). Alpha stays opaque so
+    // nothing on the way blends the data.
+    static void pack16(const float* xyz, unsigned char* rgba, size_t count);
+    
+    // the ray of pixel x, y scaled to metres per mm
+    void getRay(int x, int y, float& rayX, float& rayY) const;
+    
+private:
+    int width = 0;
+    int height = 0;
+    Intrinsics intrinsics;
+    // interleaved rayX, rayY per pixel
+    std::vector<float> rays;
+};
@@ -0,0 +1,130 @@
+#include "Recorder.h"
+#include "turbojpeg.h"
+
+Recorder::~Recorder()
+{
+    stop();
+}
+
+bool Recorder::start(const string& path, bool hasColor, bool hasDepth, bool hasIr, int jpegQuality)
+{
+    stop();
+    uint32_t streams = (hasColor ? KinectRecording::STREAM_COLOUR : 0)
+        | (hasDepth ? KinectRecording::STREAM_DEPTH : 0)
+        | (hasIr ? KinectRecording::STREAM_IR : 0);
+    if (!writer.open(path, streams, 1920, 1080, 512, 424)) {
+        ofLogError() << "could not open " << path << " for recording";
+        return false;
+    }
+    this->path = path;
+    this->hasColor = hasColor;
+    this->hasDepth = hasDepth;
+    this->hasIr = hasIr;
+    this->jpegQuality = jpegQuality;
+    dropped = 0;
+    
+    freeSlots.clear();
+    readySlots.clear();
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        freeSlots.push_back(i);
+    }
+    startThread();
+    ofLogNotice() << "recording to " << path;
+    return true;
+}
+
+void Recorder::stop()
+{
+    if (!writer.isOpen()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        stopThread();
+    }
+    queueChanged.notify_all();
+    waitForThread(false);
+    ofLogNotice() << "recorded " << writer.getFrameCount() << " frames, dropped " << dropped;
+    bool empty = writer.getFrameCount() == 0;
+    writer.close();
+    // stopped before the first frame, a file with nothing to play back
+    if (empty) {
+        std::remove(path.c_str());
+        ofLogNotice() << "removed empty recording " << path;
+    }
+}
+
+void Recorder::addFrame(const KinectFrame& frame)
+{
+    int slot;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (freeSlots.empty()) {
+            dropped++;
+            return;
+        }
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    
+    // the slot belongs to this thread until it is queued
+    if (hasColor) {
+        slots[slot].color = frame.color;
+    }
+    if (hasDepth) {
+        slots[slot].depth = frame.depth;
+    }
+    if (hasIr) {
+        slots[slot].ir = frame.ir;
+    }
+    slots[slot].sequence = frame.sequence;
+    slots[slot].captureTime = frame.captureTime;
+    
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        readySlots.push_back(slot);
+    }
+    queueChanged.notify_one();
+}
+
+void Recorder::threadedFunction()
+{
+    tjhandle compressor = tjInitCompress();
+    unsigned char* jpeg = tjAlloc(tjBufSize(1920, 1080, TJSAMP_420));
+    
+    while (true) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return !readySlots.empty() || !isThreadRunning(); });
+            // the queue is drained before stopping so nothing queued is lost
+            if (readySlots.empty()) {
+                break;
+            }
+            slot = readySlots.front();
+            readySlots.pop_front();
+        }
+        
+        const KinectFrame& frame = slots[slot];
+        unsigned long jpegSize = 0;
+        if (hasColor && frame.color.isAllocated()) {
+            int pixelFormat = frame.color.getNumChannels() == 3 ? TJPF_RGB
+                : frame.color.getPixelFormat() == OF_PIXELS_BGRA ? TJPF_BGRA : TJPF_RGBA;
+            if (tjCompress2(compressor, frame.color.getData(), frame.color.getWidth(), 0, frame.color.getHeight(), pixelFormat,
+                            &jpeg, &jpegSize, TJSAMP_420, jpegQuality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC) != 0) {
+                ofLogWarning() << "jpeg encode failed: " << tjGetErrorStr();
+                jpegSize = 0;
+            }
+        }
+        writer.write(frame.sequence, frame.captureTime,
+                     jpegSize ? jpeg : nullptr, jpegSize,
+                     hasDepth ? frame.depth.getData() : nullptr,
+                     hasIr ? frame.ir.getData() : nullptr);
+        
+        std::unique_lock<std::mutex> lock(queueMutex);
+        freeSlots.push_back(slot);
+    }
+    
+    tjFree(jpeg);
+    tjDestroy(compressor);
+}
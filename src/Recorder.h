@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ofMain.h"
+#include "CaptureThread.h"
+#include "KinectRecording.h"
+#include <condition_variable>
+#include <deque>
+
+// Writes frames to a KinectRecording file on its own thread. The colour
+// stream is JPEG encoded with turbojpeg on the way, since ofxMultiKinectV2
+// only hands out decoded pixels. addFrame() copies into one of a few
+// preallocated slots and drops the frame if the writer is behind, so a slow
+// disk never stalls the GL thread.
+
+class Recorder : public ofThread {
+public:
+    ~Recorder();
+    
+    bool start(const string& path, bool hasColor, bool hasDepth, bool hasIr, int jpegQuality);
+    void stop();
+    bool isRecording() const { return writer.isOpen(); }
+    
+    // GL thread
+    void addFrame(const KinectFrame& frame);
+    uint64_t getDroppedFrames() const { return dropped; }
+    
+protected:
+    void threadedFunction();
+    
+    static const int NUM_SLOTS = 4;
+    KinectFrame slots[NUM_SLOTS];
+    vector<int> freeSlots;
+    deque<int> readySlots;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    
+    KinectRecording::Writer writer;
+    string path;
+    bool hasColor = false;
+    bool hasDepth = false;
+    bool hasIr = false;
+    int jpegQuality = 90;
+    uint64_t dropped = 0;
+};
@@ -0,0 +1,121 @@
+#include "RecordingFrameSource.h"
+
+RecordingFrameSource::RecordingFrameSource(const string& path)
+: path(path)
+{
+}
+
+bool RecordingFrameSource::open(bool hasColor, bool hasDepth, bool hasIr)
+{
+    if (!reader.open(path)) {
+        ofLogError() << "could not open recording " << path;
+        return false;
+    }
+    const KinectRecording::FileHeader& header = reader.getHeader();
+    if (header.colorWidth != 1920 || header.colorHeight != 1080 || header.depthWidth != 512 || header.depthHeight != 424) {
+        ofLogError() << "unexpected frame size in " << path;
+        reader.close();
+        return false;
+    }
+    // waitForFrame() loops back to frame 0
+    if (reader.getFrameCount() == 0) {
+        ofLogError() << "no frames in recording " << path;
+        reader.close();
+        return false;
+    }
+    ofLogNotice() << "playing back " << reader.getFrameCount() << " frames from " << path;
+    
+    this->hasColor = hasColor;
+    this->hasDepth = hasDepth;
+    this->hasIr = hasIr;
+    decompressor = tjInitDecompress();
+    next = reader.getFrameCount();
+    prefetch = 0;
+    if (hasColor && decodeThreads > 0) {
+        decoder.start(decodeThreads, decodeQueue, 1920 / colorScale, 1080 / colorScale);
+    }
+    return true;
+}
+
+void RecordingFrameSource::setDecodeThreads(int threads, int queueDepth)
+{
+    decodeThreads = threads;
+    decodeQueue = queueDepth;
+}
+
+bool RecordingFrameSource::setColorScale(int divisor)
+{
+    // every libjpeg-turbo has 1/2, 1/4 and 1/8, check anyway
+    int count = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&count);
+    for (int i = 0; factors && i < count; i++) {
+        if (factors[i].num == 1 && factors[i].denom == divisor) {
+            colorScale = divisor;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RecordingFrameSource::close()
+{
+    // the queued JPEGs point into the mapped file
+    decoder.stop();
+    if (decompressor) {
+        tjDestroy(decompressor);
+        decompressor = nullptr;
+    }
+    reader.close();
+}
+
+bool RecordingFrameSource::waitForFrame()
+{
+    if (!reader.isOpen()) {
+        ofSleepMillis(10);
+        return false;
+    }
+    if (next == reader.getFrameCount()) {
+        next = 0;
+        start = chrono::steady_clock::now();
+        firstTimestamp = reader.getFrame(0).timestamp;
+    }
+    current = reader.getFrame(next++);
+    
+    // keep the decoder's queue full, in the order the frames are played. A
+    // recording without colour has nothing to queue, hence the bound
+    if (decoder.isRunning()) {
+        for (size_t i = 0; i < reader.getFrameCount() && decoder.getPending() < decodeQueue; i++) {
+            KinectRecording::FrameView ahead = reader.getFrame(prefetch);
+            prefetch = (prefetch + 1) % reader.getFrameCount();
+            if (ahead.jpeg) {
+                decoder.submit(ahead.jpeg, ahead.jpegSize);
+            }
+        }
+    }
+    
+    // due relative to the first frame, like the device would deliver it
+    this_thread::sleep_until(start + chrono::nanoseconds(current.timestamp - firstTimestamp));
+    return true;
+}
+
+void RecordingFrameSource::readFrame(KinectFrame& frame)
+{
+    size_t planeSize = 512 * 424 * sizeof(float);
+    if (hasColor && current.jpeg && decoder.isRunning()) {
+        decoder.next(frame.color);
+    }
+    else if (hasColor && current.jpeg) {
+        tjDecompress2(decompressor, current.jpeg, current.jpegSize, frame.color.getData(), 1920 / colorScale, 0, 1080 / colorScale, TJPF_RGBA, TJFLAG_FASTDCT);
+    }
+    if (hasDepth && current.depth) {
+        memcpy(frame.depth.getData(), current.depth, planeSize);
+    }
+    if (hasIr && current.ir) {
+        memcpy(frame.ir.getData(), current.ir, planeSize);
+    }
+}
+
+string RecordingFrameSource::getName() const
+{
+    return path;
+}
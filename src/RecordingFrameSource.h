@@ -0,0 +1,51 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "JpegDecoder.h"
+#include "KinectRecording.h"
+#include "turbojpeg.h"
+
+// Plays a KinectRecording file, paced by the recorded timestamps and looping
+// at the end. Depth and IR are copied straight out of the mapped file. With
+// decode threads the colour JPEGs of the next few frames are decoded ahead,
+// in parallel, while the current one waits for its time.
+
+class RecordingFrameSource : public FrameSource {
+public:
+    RecordingFrameSource(const string& path);
+    
+    bool open(bool hasColor, bool hasDepth, bool hasIr);
+    void close();
+    
+    bool waitForFrame();
+    void readFrame(KinectFrame& frame);
+    
+    string getName() const;
+    
+    // turbojpeg scales while decoding, skipping the pixels that would be
+    // thrown away. 1, 2, 4 or 8
+    bool setColorScale(int divisor);
+    int getColorScale() const { return colorScale; }
+    
+    // called before open(), 0 threads decodes on the capture thread
+    void setDecodeThreads(int threads, int queueDepth);
+    
+private:
+    string path;
+    KinectRecording::Reader reader;
+    tjhandle decompressor = nullptr;
+    bool hasColor = false;
+    bool hasDepth = false;
+    bool hasIr = false;
+    int colorScale = 1;
+    int decodeThreads = 0;
+    int decodeQueue = 4;
+    JpegDecoder decoder;
+    // next frame whose JPEG goes to the decoder, runs ahead of next
+    size_t prefetch = 0;
+    
+    size_t next = 0;
+    KinectRecording::FrameView current;
+    chrono::steady_clock::time_point start;
+    uint64_t firstTimestamp = 0;
+};
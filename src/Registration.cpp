@@ -0,0 +1,161 @@
+#include "Registration.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// colour pixels a position may fall back before it counts as hidden, covers
+// depth noise
+static const float OCCLUSION_SLACK = 0.5f;
+
+static bool sameIntrinsics(const PointCloud::Intrinsics& a, const PointCloud::Intrinsics& b)
+{
+    return a.fx == b.fx && a.fy == b.fy && a.cx == b.cx && a.cy == b.cy
+        && a.k1 == b.k1 && a.k2 == b.k2 && a.k3 == b.k3 && a.p1 == b.p1 && a.p2 == b.p2;
+}
+
+static bool sameCalibration(const Registration::Calibration& a, const Registration::Calibration& b)
+{
+    return sameIntrinsics(a.depth, b.depth)
+        && a.color.fx == b.color.fx && a.color.fy == b.color.fy
+        && a.color.cx == b.color.cx && a.color.cy == b.color.cy
+        && a.color.width == b.color.width && a.color.height == b.color.height
+        && a.baselineX == b.baselineX && a.baselineY == b.baselineY
+        && a.flip == b.flip
+        && a.depthWidth == b.depthWidth && a.depthHeight == b.depthHeight;
+}
+
+bool Registration::setCalibration(const Calibration& calibration)
+{
+    if (built && sameCalibration(calibration, this->calibration)) {
+        return false;
+    }
+    this->calibration = calibration;
+    build();
+    return true;
+}
+
+void Registration::build()
+{
+    const Calibration& c = calibration;
+    int width = c.depthWidth;
+    int height = c.depthHeight;
+    depthCamera.setup(width, height, c.depth);
+    base.resize(width * height * 2);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // the rays are for the unflipped image, in metres per mm with y up
+            float rayX, rayY;
+            depthCamera.getRay(c.flip ? width - 1 - x : x, y, rayX, rayY);
+            float u = c.color.fx * rayX * 1000.0f + c.color.cx;
+            float v = -c.color.fy * rayY * 1000.0f + c.color.cy;
+            if (c.flip) {
+                u = c.color.width - 1 - u;
+            }
+            base[(y * width + x) * 2] = u;
+            base[(y * width + x) * 2 + 1] = v;
+        }
+    }
+    // seen from the colour camera a point moves against the baseline, the
+    // more the closer it is. Flipping mirrors the horizontal shift too
+    shiftX = -c.color.fx * c.baselineX * (c.flip ? -1.0f : 1.0f);
+    shiftY = -c.color.fy * c.baselineY;
+    // a depth pixel covers this many colour pixels
+    splat = std::max(1, (int)std::ceil(c.color.fx / c.depth.fx));
+    built = true;
+}
+
+bool Registration::toColor(int x, int y, float depth, float& u, float& v) const
+{
+    const float* b = &base[(y * calibration.depthWidth + x) * 2];
+    u = b[0] + shiftX / depth;
+    v = b[1] + shiftY / depth;
+    return depth > 0 && u > -0.5f && v > -0.5f
+        && u < calibration.color.width - 0.5f && v < calibration.color.height - 0.5f;
+}
+
+void Registration::registerColor(const float* depth, const unsigned char* color, unsigned char* registered, WorkerPool* pool)
+{
+    int width = calibration.depthWidth;
+    int height = calibration.depthHeight;
+    int colorWidth = calibration.color.width;
+    float maxU = colorWidth - 0.5f;
+    float maxV = calibration.color.height - 0.5f;
+
+    auto forRows = [&](const WorkerPool::Task& task) {
+        if (pool) {
+            pool->parallelFor(height, task, 8);
+        }
+        else {
+            task(0, height);
+        }
+    };
+
+    // the baseline is horizontal, so along a row the colour positions of
+    // visible pixels only ever move one way. Scanning against the shift, a
+    // pixel whose colour position falls behind one already passed is hidden
+    // from the colour camera by that nearer pixel
+    bool rightToLeft = shiftX < 0;
+    forRows([&](size_t y0, size_t y1) {
+        for (size_t y = y0; y < y1; y++) {
+            float edge = rightToLeft ? FLT_MAX : -FLT_MAX;
+            for (int n = 0; n < width; n++) {
+                size_t i = y * width + (rightToLeft ? width - 1 - n : n);
+                float d = depth[i];
+                float u = base[i * 2] + shiftX / d;
+                float v = base[i * 2 + 1] + shiftY / d;
+                bool inside = d > 0 && u > -0.5f && v > -0.5f && u < maxU && v < maxV;
+                if (inside && occlusionFilter) {
+                    if (rightToLeft ? u > edge + OCCLUSION_SLACK : u < edge - OCCLUSION_SLACK) {
+                        inside = false;
+                    }
+                    else {
+                        edge = rightToLeft ? std::min(edge, u) : std::max(edge, u);
+                    }
+                }
+                uint32_t pixel = 0;
+                if (inside) {
+                    memcpy(&pixel, color + ((int)(v + 0.5f) * colorWidth + (int)(u + 0.5f)) * 4, 4);
+                }
+                memcpy(registered + i * 4, &pixel, 4);
+            }
+        }
+    });
+}
+
+void Registration::mapDepth(const float* depth, float* colorDepth)
+{
+    int width = calibration.depthWidth;
+    int height = calibration.depthHeight;
+    int colorWidth = calibration.color.width;
+    int colorHeight = calibration.color.height;
+    std::fill(colorDepth, colorDepth + colorWidth * colorHeight, 0.0f);
+
+    int before = splat / 2;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int i = y * width + x;
+            float d = depth[i];
+            float u, v;
+            if (!toColor(x, y, d, u, v)) {
+                continue;
+            }
+            int u0 = std::max((int)(u + 0.5f) - before, 0);
+            int v0 = std::max((int)(v + 0.5f) - before, 0);
+            int u1 = std::min(u0 + splat, colorWidth);
+            int v1 = std::min(v0 + splat, colorHeight);
+            for (int cy = v0; cy < v1; cy++) {
+                float* row = colorDepth + cy * colorWidth;
+                for (int cx = u0; cx < u1; cx++) {
+                    if (row[cx] == 0 || d < row[cx]) {
+                        row[cx] = d;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "PointCloud.h"
+
+class WorkerPool;
+
+// Colour and depth registration.
+//
+// The Kinect v2 colour camera sits beside the depth camera with parallel
+// optical axes, so a depth pixel with depth d lands on the colour image at
+//
+//   u = u0 + shiftX / d,  v = v0 + shiftY / d
+//
+// where u0, v0 is where the pixel's (undistorted) ray meets the colour image
+// at infinity and shiftX, shiftY the baseline in colour pixels times mm. The
+// u0, v0 table is built once per calibration, so a frame costs a divide and
+// two multiply-adds per pixel. The tables are only rebuilt when
+// setCalibration() is given different values, e.g. when the images flip.
+//
+// registerColor() samples colour for every depth pixel. A depth pixel hidden
+// from the colour camera by something closer would pick up the occluder's
+// colour; the occlusion filter finds those in the same pass, one scan per
+// row, and they come out as 0 (alpha 0) like pixels without depth or
+// outside the colour image.
+//
+// mapDepth() goes the other way, splatting every depth pixel onto a colour
+// sized image with a z-test so the nearest surface wins. Colour pixels no
+// depth pixel reaches are 0.
+
+class Registration {
+public:
+    // pinhole model in pixels of the colour image, typical factory values
+    struct ColorIntrinsics {
+        float fx = 1081.37f;
+        float fy = 1081.37f;
+        float cx = 959.5f;
+        float cy = 539.5f;
+        int width = 1920;
+        int height = 1080;
+    };
+
+    struct Calibration {
+        PointCloud::Intrinsics depth;
+        ColorIntrinsics color;
+        // colour camera position relative to the depth camera in mm, x to
+        // the right and y down in the image
+        float baselineX = 52.0f;
+        float baselineY = 0.0f;
+        // both images mirrored horizontally, as the device does when flipped
+        bool flip = false;
+        int depthWidth = 512;
+        int depthHeight = 424;
+    };
+
+    // returns true if the tables were rebuilt
+    bool setCalibration(const Calibration& calibration);
+    const Calibration& getCalibration() const { return calibration; }
+
+    void setOcclusionFilter(bool enabled) { occlusionFilter = enabled; }
+    bool getOcclusionFilter() const { return occlusionFilter; }
+
+    // color is the colour image with 4 bytes per pixel, registered receives
+    // a depth sized image in the same pixel format. pool may be null
+    void registerColor(const float* depth, const unsigned char* color, unsigned char* registered, WorkerPool* pool);
+
+    // colorDepth receives a colour sized image of depth in mm
+    void mapDepth(const float* depth, float* colorDepth);
+
+    // the colour pixel depth pixel x, y lands on at the given depth, false if
+    // outside the colour image
+    bool toColor(int x, int y, float depth, float& u, float& v) const;
+
+private:
+    void build();
+
+    Calibration calibration;
+    bool built = false;
+    bool occlusionFilter = true;
+
+    PointCloud depthCamera;
+    // interleaved u0, v0 per depth pixel
+    std::vector<float> base;
+    float shiftX = 0.0f;
+    float shiftY = 0.0f;
+    int splat = 1;
+
+};
@@ -0,0 +1,984 @@
+#include "Sensor.h"
+#include "PixelKernels.h"
+#include "DeviceFrameSource.h"
+#include "NetworkTransport.h"
+#include "RecordingFrameSource.h"
+#include "SharedMemoryTransport.h"
+#include "SyntheticFrameSource.h"
+
+// short names of Sensor::Stream, used in SHM_STREAMS, NET_STREAMS and the
+// transport names
+static const string streamNames[] = { "colour", "depth", "ir", "points", "registeredcolour" };
+
+namespace {
+
+    // a sensor's tags come from its SENSOR block, and otherwise from the top
+    // level so settings every sensor shares are written once
+    class SensorSettings {
+    public:
+        SensorSettings(ofxXmlSettings& XML, int index)
+        : XML(XML)
+        , index(index)
+        {
+        }
+
+        int get(const string& tag, int value) { return getOwn(tag, XML.getValue(tag, value)); }
+        double get(const string& tag, double value) { return getOwn(tag, XML.getValue(tag, value)); }
+        string get(const string& tag, const string& value) { return getOwn(tag, XML.getValue(tag, value)); }
+
+        // only from the SENSOR block, for tags that must differ between sensors
+        int getOwn(const string& tag, int value)
+        {
+            if (push()) {
+                value = XML.getValue(tag, value);
+                pop();
+            }
+            return value;
+        }
+
+        double getOwn(const string& tag, double value)
+        {
+            if (push()) {
+                value = XML.getValue(tag, value);
+                pop();
+            }
+            return value;
+        }
+
+        string getOwn(const string& tag, const string& value)
+        {
+            string result = value;
+            if (push()) {
+                result = XML.getValue(tag, value);
+                pop();
+            }
+            return result;
+        }
+
+    private:
+        bool push()
+        {
+            if (index < 0) {
+                return false;
+            }
+            XML.pushTag("SENSORS");
+            XML.pushTag("SENSOR", index);
+            return true;
+        }
+
+        void pop()
+        {
+            XML.popTag();
+            XML.popTag();
+        }
+
+        ofxXmlSettings& XML;
+        int index;
+    };
+
+}
+
+//========================================================================
+
+Sensor::Sensor(const Shared& shared)
+: shared(shared)
+, stats(*shared.stats)
+{
+}
+
+void Sensor::setup(ofxXmlSettings& XML, int index)
+{
+    this->index = index;
+    SensorSettings settings(XML, index);
+    bool listed = index >= 0;
+    string suffix = listed ? "-" + ofToString(index) : "";
+    name = settings.getOwn("NAME", listed ? "KinectV2 " + ofToString(index) : "KinectV2");
+    oscPrefix = listed ? "/sensor/" + ofToString(index) : "";
+
+    openCLDevice = settings.get("OPENCLDEVICE", 0);
+    flip = settings.get("FLIP", 0);
+    hasColor = settings.get("HAS_COLOUR", 1);
+    hasIr = settings.get("HAS_IR", 1);
+    hasDepth = settings.get("HAS_DEPTH", 1);
+    hasRawDepth = settings.get("HAS_RAW_DEPTH", 0);
+    hasForeground = settings.get("HAS_FOREGROUND", 0);
+    hasBlobs = settings.get("HAS_BLOBS", 0);
+    hasPoints = settings.get("HAS_POINTS", 0);
+    hasRegisteredColour = settings.get("HAS_REGISTERED_COLOUR", 0);
+    hasColourDepth = settings.get("HAS_COLOUR_DEPTH", 0);
+
+    spatialFilter.setup(512, 424);
+    if (!spatialFilter.setChain(settings.get("SPATIAL_FILTERS", ""))) {
+        ofLogWarning() << name << ": unknown filter in SPATIAL_FILTERS, running " << spatialFilter.getChain();
+    }
+    spatialFilter.setBilateralRadius(settings.get("BILATERAL_RADIUS", 2));
+    spatialFilter.setBilateralSigmas(settings.get("BILATERAL_SIGMA_SPACE", 1.5), settings.get("BILATERAL_SIGMA_RANGE", 2000.0), settings.get("BILATERAL_SIGMA_DEPTH", 40.0));
+    spatialFilter.setFillIterations(settings.get("FILL_ITERATIONS", 2));
+    spatialDepth.allocate(512, 424, 1);
+
+    background.setup(512, 424);
+    background.setMode(settings.get("BACKGROUND_MODE", "median") == "farthest" ? BackgroundModel::MODE_FARTHEST : BackgroundModel::MODE_MEDIAN);
+    background.setThreshold(settings.get("BACKGROUND_THRESHOLD", 80.0));
+    backgroundFrames = settings.get("BACKGROUND_FRAMES", 60);
+    backgroundFile = settings.getOwn("BACKGROUND_FILE", "background" + suffix + ".bin");
+    blobNear = settings.get("BLOB_NEAR", 500.0);
+    blobFar = settings.get("BLOB_FAR", 4000.0);
+    blobFinder.setMinArea(settings.get("BLOB_MIN_AREA", 100));
+    blobFinder.setMaxBlobs(settings.get("BLOB_MAX_COUNT", 32));
+    blobMask.allocate(512, 424, 1);
+
+    PointCloud::Intrinsics intrinsics;
+    intrinsics.fx = settings.get("DEPTH_FX", intrinsics.fx);
+    intrinsics.fy = settings.get("DEPTH_FY", intrinsics.fy);
+    intrinsics.cx = settings.get("DEPTH_CX", intrinsics.cx);
+    intrinsics.cy = settings.get("DEPTH_CY", intrinsics.cy);
+    intrinsics.k1 = settings.get("DEPTH_K1", intrinsics.k1);
+    intrinsics.k2 = settings.get("DEPTH_K2", intrinsics.k2);
+    intrinsics.k3 = settings.get("DEPTH_K3", intrinsics.k3);
+    intrinsics.p1 = settings.get("DEPTH_P1", intrinsics.p1);
+    intrinsics.p2 = settings.get("DEPTH_P2", intrinsics.p2);
+    if (hasPoints) {
+        pointCloud.setup(512, 424, intrinsics);
+        positionPixels.allocate(512, 424, 3);
+    }
+    calibration.depth = intrinsics;
+    calibration.color.fx = settings.get("COLOUR_FX", calibration.color.fx);
+    calibration.color.fy = settings.get("COLOUR_FY", calibration.color.fy);
+    calibration.color.cx = settings.get("COLOUR_CX", calibration.color.cx);
+    calibration.color.cy = settings.get("COLOUR_CY", calibration.color.cy);
+    calibration.baselineX = settings.get("REGISTRATION_BASELINE_X", calibration.baselineX);
+    calibration.baselineY = settings.get("REGISTRATION_BASELINE_Y", calibration.baselineY);
+    registration.setOcclusionFilter(settings.get("REGISTRATION_OCCLUSION", 1));
+    pose.x = settings.get("POSE_X", pose.x);
+    pose.y = settings.get("POSE_Y", pose.y);
+    pose.z = settings.get("POSE_Z", pose.z);
+    pose.yaw = settings.get("POSE_YAW", pose.yaw);
+    pose.pitch = settings.get("POSE_PITCH", pose.pitch);
+    pose.roll = settings.get("POSE_ROLL", pose.roll);
+    if (hasColourDepth) {
+        colourDepth.allocate(1920, 1080, 1);
+    }
+
+    colourScaler.setup(1920, 1080);
+    vector<string> scales = ofSplitString(settings.get("COLOUR_SCALES", ""), ",", true, true);
+    for (size_t i = 0; i < scales.size(); i++) {
+        if (!colourScaler.addScale(ofToInt(scales[i]))) {
+            ofLogWarning() << name << ": COLOUR_SCALES: " << scales[i] << " is not 2, 4 or 8";
+        }
+    }
+    vector<string> roi = ofSplitString(settings.get("COLOUR_ROI", ""), ",", true, true);
+    if (roi.size() == 4) {
+        colourScaler.setRoi(ofToInt(roi[0]), ofToInt(roi[1]), ofToInt(roi[2]), ofToInt(roi[3]));
+    }
+    else if (!roi.empty()) {
+        ofLogWarning() << name << ": COLOUR_ROI should be x,y,width,height";
+    }
+    if (hasForeground && !background.load(ofToDataPath(backgroundFile))) {
+        ofLogNotice() << name << ": no background in " << backgroundFile << ", learn one with 'b' or /background/learn";
+    }
+    temporalFiltering = settings.get("TEMPORAL_FILTER", 0);
+    temporalFilter.setAlpha(settings.get("TEMPORAL_ALPHA", 0.3));
+    temporalFilter.setMotionThreshold(settings.get("TEMPORAL_MOTION", 100.0));
+    temporalFilter.setHoldFrames(settings.get("TEMPORAL_HOLD", 3));
+    temporalFilter.setup(512, 424);
+    filteredDepth.allocate(512, 424, 1);
+
+    // DEVICE is an index into the connected Kinects or a serial number, which
+    // stays the same when they are plugged in a different order
+    string device = settings.getOwn("DEVICE", ofToString(listed ? index : 0));
+    int deviceIndex = ofToInt(device);
+    if (device.size() > 2 || device.find_first_not_of("0123456789") != string::npos) {
+        deviceIndex = DeviceFrameSource::findDevice(device);
+        if (deviceIndex < 0) {
+            ofLogError() << name << ": no Kinect with serial " << device << ", using the first one";
+            deviceIndex = 0;
+        }
+    }
+
+    // SOURCE picks where frames come from, a PLAYBACK_FILE on its own still
+    // replaces the device like before
+    string playbackFile = settings.get("PLAYBACK_FILE", "");
+    string sourceName = settings.get("SOURCE", playbackFile.empty() ? "device" : "file");
+    if (sourceName == "synthetic") {
+        SyntheticScene::Settings scene;
+        scene.planes = settings.get("SYNTHETIC_PLANES", 3);
+        scene.noise = settings.get("SYNTHETIC_NOISE", 4.0);
+        scene.holes = settings.get("SYNTHETIC_HOLES", 0.01);
+        source.reset(new SyntheticFrameSource(scene, settings.get("SYNTHETIC_FPS", 30.0)));
+    }
+    else if (sourceName == "file") {
+        RecordingFrameSource* recording = new RecordingFrameSource(ofToDataPath(playbackFile));
+        recording->setDecodeThreads(settings.get("JPEG_DECODE_THREADS", 2), settings.get("JPEG_DECODE_QUEUE", 4));
+        source.reset(recording);
+    }
+    else {
+        source.reset(new DeviceFrameSource(deviceIndex, openCLDevice));
+    }
+    // with only reduced colour outputs a source that can skip pixels, like a
+    // JPEG recording, produces the largest of them straight away
+    if (!hasColor && !hasRegisteredColour && !colourScaler.hasRoi()) {
+        for (int i = 0; i < ColourScaler::LEVELS; i++) {
+            int divisor = 2 << i;
+            if (colourScaler.hasScale(divisor)) {
+                if (source->setColorScale(divisor)) {
+                    ofLogNotice() << name << ": colour comes from the source at 1/" << divisor << " size";
+                }
+                break;
+            }
+        }
+    }
+    bool opened = source->open(needsColor(), needsDepth(), hasIr);
+    if (!opened && (sourceName == "synthetic" || sourceName == "file")) {
+        ofLogError() << name << ": could not open " << source->getName() << ", falling back to the device";
+        source.reset(new DeviceFrameSource(deviceIndex, openCLDevice));
+        opened = source->open(needsColor(), needsDepth(), hasIr);
+    }
+    // without a source the sensor stays up, its outputs just never get a frame
+    if (opened) {
+        ofLogNotice() << name << ": capturing from " << source->getName();
+    }
+    else {
+        ofLogError() << name << ": could not open " << source->getName() << ", not capturing";
+    }
+    recordJpegQuality = settings.get("RECORD_JPEG_QUALITY", 90);
+    setupTransports(XML);
+
+    capturingDepth = needsDepth();
+    capture.setup(*source, stats, needsColor(), capturingDepth, hasIr);
+    if (opened) {
+        capture.startThread();
+    }
+
+    if (shared.cpuConversion) {
+        if (hasDepth) {
+            depthPixels.allocate(512, 424, 1);
+        }
+        if (hasIr) {
+            irPixels.allocate(512, 424, 1);
+        }
+    }
+    // raw depth only goes out through Syphon, headless nobody takes it
+    if (hasRawDepth && shared.headless) {
+        rawDepthConsumed = false;
+    }
+    if (hasRawDepth && !shared.headless) {
+        rawDepthPixels.allocate(512, 424, 4);
+    }
+    // likewise the foreground, headless it only feeds the blobs
+    if (hasForeground && shared.headless) {
+        foregroundConsumed = false;
+    }
+    if (hasForeground && !shared.headless) {
+        foregroundPixels.allocate(512, 424, 4);
+    }
+    if (hasPoints && !shared.headless) {
+        positionTex.allocate(512, 424, GL_RGB32F);
+        pointsPacked.allocate(1024, 424, 4);
+    }
+    if (hasColourDepth && !shared.headless) {
+        colourDepthPixels.allocate(1920, 1080, 4);
+    }
+    if (shared.headless) {
+        return;
+    }
+
+    if (hasColor) {
+        colourSyphon.setName(name + " Colour");
+    }
+    if (hasDepth) {
+        depthSyphon.setName(name + " Depth");
+        depthFbo.allocate(512, 424);
+    }
+    if (hasIr) {
+        iRSyphon.setName(name + " IR");
+        irFbo.allocate(512, 424);
+    }
+    if (hasRawDepth) {
+        rawDepthSyphon.setName(name + " Raw Depth");
+    }
+    if (hasForeground) {
+        foregroundSyphon.setName(name + " Foreground");
+    }
+    if (hasPoints) {
+        pointsSyphon.setName(name + " Points");
+    }
+    if (hasRegisteredColour) {
+        registeredColourSyphon.setName(name + " Registered Colour");
+    }
+    if (hasColourDepth) {
+        colourDepthSyphon.setName(name + " Colour Depth");
+    }
+    for (int i = 0; i < ColourScaler::LEVELS; i++) {
+        int divisor = 2 << i;
+        if (colourScaler.hasScale(divisor)) {
+            scaledColourSyphon[i].setName(name + " Colour " + ofToString(colourScaler.getScaledWidth(divisor)) + "x" + ofToString(colourScaler.getScaledHeight(divisor)));
+        }
+    }
+    if (colourScaler.hasRoi()) {
+        roiColourSyphon.setName(name + " Colour ROI");
+    }
+}
+
+bool Sensor::update()
+{
+    // headless has no Syphon servers, everything is converted
+    if (!shared.headless) {
+        colorConsumed = isConsumed(colourSyphon, true);
+        depthConsumed = isConsumed(depthSyphon, true);
+        irConsumed = isConsumed(iRSyphon, true);
+        rawDepthConsumed = isConsumed(rawDepthSyphon, false);
+        foregroundConsumed = isConsumed(foregroundSyphon, false);
+        pointsConsumed = isConsumed(pointsSyphon, false);
+        registeredColourConsumed = isConsumed(registeredColourSyphon, false) || hasTransportClients(STREAM_REGISTERED_COLOUR);
+        colourDepthConsumed = isConsumed(colourDepthSyphon, false);
+        for (int i = 0; i < ColourScaler::LEVELS; i++) {
+            scaledColourConsumed[i] = isConsumed(scaledColourSyphon[i], false);
+        }
+        roiColourConsumed = isConsumed(roiColourSyphon, false);
+    }
+
+    if (!capture.update()) {
+        return false;
+    }
+    const KinectFrame& frame = capture.getFrame();
+
+    stats.add(FrameStats::COUNTER_RECEIVED);
+    if (lastSequence) {
+        stats.add(FrameStats::COUNTER_DROPPED, frame.sequence - lastSequence - 1);
+    }
+    lastSequence = frame.sequence;
+
+    if (recorder.isRecording()) {
+        recorder.addFrame(frame);
+    }
+
+    colorSkipped += hasColor && !colorConsumed;
+    depthSkipped += hasDepth && !depthConsumed;
+    irSkipped += hasIr && !irConsumed;
+    rawDepthSkipped += hasRawDepth && !rawDepthConsumed;
+
+    // filtered depth replaces the device depth for every output, the
+    // recorder above still gets the raw frames
+    const ofFloatPixels* depth = &frame.depth;
+    bool foregroundActive = hasForeground && (foregroundConsumed || background.isLearning());
+    bool filtering = (hasDepth && depthConsumed) || (hasRawDepth && rawDepthConsumed) || foregroundActive || hasBlobs || hasPoints
+        || (hasRegisteredColour && registeredColourConsumed) || (hasColourDepth && colourDepthConsumed) || hasTransportClients(STREAM_DEPTH) || shared.fusion;
+    if (filtering && spatialFilter.isActive()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_FILTER_SPATIAL));
+        spatialFilter.apply(depth->getData(), hasIr ? frame.ir.getData() : nullptr, spatialDepth.getData(), shared.pool);
+        depth = &spatialDepth;
+    }
+    if (filtering && temporalFiltering) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_FILTER_TEMPORAL));
+        temporalFilter.apply(depth->getData(), filteredDepth.getData(), shared.pool);
+        depth = &filteredDepth;
+    }
+    processedDepth = depth;
+
+    if (shared.cpuConversion) {
+        if (hasDepth && depthConsumed) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_CONVERT_DEPTH));
+            shared.depthMapping->toGrey(depth->getData(), depthPixels.getData(), depthPixels.size());
+        }
+        if (hasIr && irConsumed) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_CONVERT_IR));
+            PixelKernels::irToGrey(frame.ir.getData(), irPixels.getData(), irPixels.size());
+        }
+    }
+
+    // raw depth never goes through a shader, the millimetres are packed
+    // into R and G so they survive Syphon's 8-bit surfaces
+    if (hasRawDepth && rawDepthConsumed) {
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_CONVERT_RAW_DEPTH));
+            PixelKernels::packDepth16(depth->getData(), rawDepthPixels.getData(), depth->size());
+        }
+        ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_RAW_DEPTH));
+        rawDepthTex.loadData(rawDepthPixels);
+    }
+
+    if (hasForeground && background.isLearning()) {
+        background.add(depth->getData());
+        if (!background.isLearning()) {
+            ofLogNotice() << name << ": background learned";
+            sendBackgroundState();
+        }
+    }
+    // one pass gives both the published foreground and the blobs' mask
+    bool masking = hasForeground && background.hasBackground();
+    bool publishingForeground = masking && foregroundConsumed;
+    if (publishingForeground || (masking && hasBlobs)) {
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_CONVERT_FOREGROUND));
+            background.foreground(depth->getData(), hasBlobs ? blobMask.getData() : nullptr, publishingForeground ? foregroundPixels.getData() : nullptr);
+        }
+        if (publishingForeground) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_FOREGROUND));
+            foregroundTex.loadData(foregroundPixels);
+        }
+    }
+
+    if (hasBlobs) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_BLOBS));
+        if (!masking) {
+            BlobFinder::threshold(depth->getData(), blobNear, blobFar, blobMask.getData(), blobMask.size());
+        }
+        blobFinder.find(blobMask.getData(), depth->getData(), blobMask.getWidth(), blobMask.getHeight());
+        sendBlobs(frame);
+    }
+
+    // the position texture is always kept current for GL use, the packed
+    // stream only when someone is watching
+    if (hasPoints) {
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_CONVERT_POINTS));
+            pointCloud.unproject(depth->getData(), positionPixels.getData());
+            if (!shared.headless && pointsConsumed) {
+                PointCloud::pack16(positionPixels.getData(), pointsPacked.getData(), positionPixels.getWidth() * positionPixels.getHeight());
+            }
+        }
+        if (!shared.headless) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_POINTS));
+            positionTex.loadData(positionPixels);
+            if (pointsConsumed) {
+                pointsTex.loadData(pointsPacked);
+            }
+        }
+    }
+
+    if (hasRegisteredColour || hasColourDepth) {
+        // flipping mirrors both images, only then are the tables rebuilt
+        calibration.flip = source->getFlip();
+        registration.setCalibration(calibration);
+    }
+    if (hasRegisteredColour && registeredColourConsumed && frame.color.isAllocated()) {
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_REGISTER_COLOUR));
+            if (!registeredColourPixels.isAllocated()) {
+                registeredColourPixels.allocate(512, 424, frame.color.getPixelFormat());
+            }
+            registration.registerColor(depth->getData(), frame.color.getData(), registeredColourPixels.getData(), shared.pool);
+        }
+        if (!shared.headless) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_REGISTERED_COLOUR));
+            registeredColourTex.loadData(registeredColourPixels);
+        }
+    }
+    if (hasColourDepth && colourDepthConsumed) {
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_REGISTER_DEPTH));
+            registration.mapDepth(depth->getData(), colourDepth.getData());
+            if (!shared.headless) {
+                PixelKernels::packDepth16(colourDepth.getData(), colourDepthPixels.getData(), colourDepth.size());
+            }
+        }
+        if (!shared.headless) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_COLOUR_DEPTH));
+            colourDepthTex.loadData(colourDepthPixels);
+        }
+    }
+
+    bool scaling = colourScaler.hasRoi() && roiColourConsumed;
+    for (int i = 0; i < ColourScaler::LEVELS; i++) {
+        scaling |= colourScaler.hasScale(2 << i) && scaledColourConsumed[i];
+    }
+    if (scaling && frame.color.isAllocated()) {
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_SCALE_COLOUR));
+            colourScaler.process(frame.color.getData(), source->getColorScale(), shared.pool);
+        }
+        if (!shared.headless) {
+            // the scaler's buffers are uploaded in place
+            ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_SCALED_COLOUR));
+            for (int i = 0; i < ColourScaler::LEVELS; i++) {
+                int divisor = 2 << i;
+                if (colourScaler.hasScale(divisor) && scaledColourConsumed[i]) {
+                    scaledColourPixels[i].setFromExternalPixels(colourScaler.getScaled(divisor), colourScaler.getScaledWidth(divisor), colourScaler.getScaledHeight(divisor), frame.color.getPixelFormat());
+                    scaledColourTex[i].loadData(scaledColourPixels[i]);
+                }
+            }
+            if (colourScaler.hasRoi() && roiColourConsumed) {
+                roiColourPixels.setFromExternalPixels(colourScaler.getRoi(), colourScaler.getRoiWidth(), colourScaler.getRoiHeight(), frame.color.getPixelFormat());
+                roiColourTex.loadData(roiColourPixels);
+            }
+        }
+    }
+
+    publishTransports(frame, *depth);
+
+    if (shared.headless) {
+        framePublished(frame);
+        return true;
+    }
+
+    if (hasColor && colorConsumed) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_COLOUR));
+        colorTex.loadData(frame.color);
+    }
+    if (hasDepth && depthConsumed) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_DEPTH));
+        if (shared.cpuConversion) {
+            depthTex.loadData(depthPixels);
+        }
+        else {
+            depthTex.loadData(*depth);
+        }
+    }
+    if (hasIr && irConsumed) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_UPLOAD_IR));
+        if (shared.cpuConversion) {
+            irTex.loadData(irPixels);
+        }
+        else {
+            irTex.loadData(frame.ir);
+        }
+    }
+    return true;
+}
+
+void Sensor::draw(float y)
+{
+    bool published = false;
+
+    if (hasColor && colorConsumed) {
+        if (colorTex.isAllocated()) {
+            if (!shared.minimised) {
+                colorTex.draw(0, y, 640, 360);
+            }
+            ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_COLOUR));
+            colourSyphon.publishTexture(&colorTex);
+            published = true;
+        }
+    }
+
+    // with CPU_CONVERSION the textures already hold the converted image
+    if (hasDepth && depthConsumed && depthTex.isAllocated()) {
+        ofTexture* depthOut = &depthTex;
+        if (!shared.cpuConversion) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_SHADER_DEPTH));
+            depthFbo.begin();
+            ofClear(0, 0, 0);
+            shared.depthShader->begin();
+            shared.depthShader->setUniformTexture("lut", *shared.depthLutTex, 1);
+            depthTex.draw(0, 0, 512, 424);
+            shared.depthShader->end();
+            depthFbo.end();
+            depthOut = &depthFbo.getTexture();
+        }
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_DEPTH));
+            depthSyphon.publishTexture(depthOut);
+            published = true;
+        }
+        if (!shared.minimised) {
+            depthOut->draw(640, y, 512, 424);
+        }
+    }
+
+    if (hasIr && irConsumed && irTex.isAllocated()) {
+        ofTexture* irOut = &irTex;
+        if (!shared.cpuConversion) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_SHADER_IR));
+            irFbo.begin();
+            ofClear(0,0,0);
+            shared.irShader->begin();
+            irTex.draw(0, 0, 512, 424);
+            shared.irShader->end();
+            irFbo.end();
+            irOut = &irFbo.getTexture();
+        }
+        {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_IR));
+            iRSyphon.publishTexture(irOut);
+            published = true;
+        }
+        if (!shared.minimised) {
+            irOut->draw(1152, y, 512, 424);
+        }
+    }
+
+    if (hasRawDepth && rawDepthConsumed && rawDepthTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_RAW_DEPTH));
+        rawDepthSyphon.publishTexture(&rawDepthTex);
+        published = true;
+    }
+
+    if (hasForeground && foregroundConsumed && foregroundTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_FOREGROUND));
+        foregroundSyphon.publishTexture(&foregroundTex);
+        published = true;
+    }
+
+    if (hasPoints && pointsConsumed && pointsTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_POINTS));
+        pointsSyphon.publishTexture(&pointsTex);
+        published = true;
+    }
+
+    if (hasRegisteredColour && registeredColourConsumed && registeredColourTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_REGISTERED_COLOUR));
+        registeredColourSyphon.publishTexture(&registeredColourTex);
+        published = true;
+    }
+
+    if (hasColourDepth && colourDepthConsumed && colourDepthTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_COLOUR_DEPTH));
+        colourDepthSyphon.publishTexture(&colourDepthTex);
+        published = true;
+    }
+
+    for (int i = 0; i < ColourScaler::LEVELS; i++) {
+        if (colourScaler.hasScale(2 << i) && scaledColourConsumed[i] && scaledColourTex[i].isAllocated()) {
+            ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_SCALED_COLOUR));
+            scaledColourSyphon[i].publishTexture(&scaledColourTex[i]);
+            published = true;
+        }
+    }
+    if (colourScaler.hasRoi() && roiColourConsumed && roiColourTex.isAllocated()) {
+        ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_SCALED_COLOUR));
+        roiColourSyphon.publishTexture(&roiColourTex);
+        published = true;
+    }
+
+    if (published) {
+        framePublished(capture.getFrame());
+    }
+
+    ofPushStyle();
+    // with a list every row is labelled, a single sensor looks as it always did
+    string label = index >= 0 ? name + ", " : "";
+    ofDrawBitmapStringHighlight(label + "OpenCL Device : " + ofToString(openCLDevice), 10, y + 40);
+    ofDrawBitmapStringHighlight("Skipped frames colour " + ofToString(colorSkipped) + " depth " + ofToString(depthSkipped) + " ir " + ofToString(irSkipped) + " raw " + ofToString(rawDepthSkipped), 300, y + 20);
+    ofPopStyle();
+}
+
+void Sensor::exit()
+{
+    recorder.stop();
+    capture.stopThread();
+    capture.waitForThread();
+    source->close();
+    for (int i = 0; i < STREAM_COUNT; i++) {
+        transports[i].clear();
+    }
+}
+
+void Sensor::receive(const string& address, const ofxOscMessage& m)
+{
+    if ( address == "/flip" ){
+        flip=m.getArgAsInt32(0);
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/flip");
+        myMessage.addIntArg(flip);
+        shared.sender->sendMessage(myMessage);
+    }
+
+    // the whole chain as a comma separated string, or one filter on or off
+    if ( address == "/depth/spatial" ){
+        spatialFilter.setChain(m.getArgAsString(0));
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/depth/spatial");
+        myMessage.addStringArg(spatialFilter.getChain());
+        shared.sender->sendMessage(myMessage);
+    }
+
+    SpatialFilter::Type spatialType;
+    if ( address.find("/depth/spatial/") == 0 && SpatialFilter::parseFilter(address.substr(15), spatialType) ){
+        spatialFilter.setEnabled(spatialType, m.getArgAsInt32(0));
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/depth/spatial");
+        myMessage.addStringArg(spatialFilter.getChain());
+        shared.sender->sendMessage(myMessage);
+    }
+
+    if ( address == "/depth/temporal" ){
+        temporalFiltering=m.getArgAsInt32(0);
+        // stale state would bleed into the first frames
+        temporalFilter.reset();
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/depth/temporal");
+        myMessage.addIntArg(temporalFiltering);
+        shared.sender->sendMessage(myMessage);
+    }
+
+    if ( address == "/depth/temporal/alpha" ){
+        temporalFilter.setAlpha(ofClamp(m.getArgAsFloat(0), 0, 1));
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/depth/temporal/alpha");
+        myMessage.addFloatArg(temporalFilter.getAlpha());
+        shared.sender->sendMessage(myMessage);
+    }
+
+    if ( address == "/record/start" ){
+        string file = m.getNumArgs() ? m.getArgAsString(0) : "";
+        // sent to every sensor, each records to its own file
+        if (!file.empty() && index >= 0) {
+            size_t dot = file.rfind('.');
+            file.insert(dot == string::npos ? file.size() : dot, "-" + ofToString(index));
+        }
+        startRecording(file);
+    }
+
+    if ( address == "/record/stop" ){
+        stopRecording();
+    }
+
+    // optional number of frames to learn over
+    if ( address == "/background/learn" ){
+        // frames are only fed to the model for the foreground output
+        if (!hasForeground) {
+            ofLogWarning() << name << ": /background/learn needs HAS_FOREGROUND";
+        }
+        else {
+            background.learn(m.getNumArgs() > 0 ? m.getArgAsInt32(0) : backgroundFrames);
+        }
+        sendBackgroundState();
+    }
+
+    // optional file name, BACKGROUND_FILE otherwise
+    if ( address == "/background/save" ){
+        string file = m.getNumArgs() > 0 ? m.getArgAsString(0) : backgroundFile;
+        if (!background.save(ofToDataPath(file))) {
+            ofLogError() << name << ": could not save background to " << file;
+        }
+    }
+
+    if ( address == "/background/load" ){
+        string file = m.getNumArgs() > 0 ? m.getArgAsString(0) : backgroundFile;
+        if (!background.load(ofToDataPath(file))) {
+            ofLogError() << name << ": could not load background from " << file;
+        }
+        sendBackgroundState();
+    }
+
+    if ( address == "/blobs" ){
+        // the capture thread only gets depth if something needed it at setup
+        if (m.getArgAsInt32(0) && !capturingDepth) {
+            ofLogWarning() << name << ": /blobs needs depth, which is not being captured";
+        }
+        else {
+            hasBlobs = m.getArgAsInt32(0);
+        }
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/blobs/enabled");
+        myMessage.addIntArg(hasBlobs);
+        shared.sender->sendMessage(myMessage);
+    }
+
+    if ( address == "/background/threshold" ){
+        background.setThreshold(m.getArgAsFloat(0));
+        ofxOscMessage  myMessage;
+        myMessage.setAddress(oscPrefix + "/background/threshold");
+        myMessage.addFloatArg(background.getThreshold());
+        shared.sender->sendMessage(myMessage);
+    }
+}
+
+void Sensor::toggleFlip()
+{
+    source->setFlip(!source->getFlip());
+    ofxOscMessage  myMessage;
+    myMessage.setAddress(oscPrefix + "/flip");
+    myMessage.addIntArg(flip);
+    shared.sender->sendMessage(myMessage);
+}
+
+void Sensor::learnBackground()
+{
+    if (hasForeground) {
+        background.learn(backgroundFrames);
+    }
+    sendBackgroundState();
+}
+
+// the first publish of a frame records its latency from capture, publishing
+// the same frame again (the draw loop runs faster than the Kinect) counts as
+// a duplicate
+void Sensor::framePublished(const KinectFrame& frame)
+{
+    if (frame.sequence == publishedSequence) {
+        stats.add(FrameStats::COUNTER_DUPLICATED);
+        return;
+    }
+    publishedSequence = frame.sequence;
+    uint64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    stats.get(FrameStats::STAGE_CAPTURE_TO_PUBLISH).record(now - frame.captureTime);
+}
+
+// SHM_STREAMS lists the streams to put in shared memory, as
+// /<SHM_PREFIX>-<stream> rings of SHM_SLOTS frames, NET_STREAMS the ones to
+// send to NET_IP:NET_PORT. Sensors in a list each get their own prefix and
+// port unless their block sets one
+void Sensor::setupTransports(ofxXmlSettings& XML)
+{
+    SensorSettings settings(XML, index);
+    string suffix = index >= 0 ? "-" + ofToString(index) : "";
+    string prefix = settings.getOwn("SHM_PREFIX", XML.getValue("SHM_PREFIX", "kinectv2") + suffix);
+    int slots = settings.get("SHM_SLOTS", 3);
+    for (int stream : parseStreams(XML, "SHM_STREAMS")) {
+        transports[stream].push_back(unique_ptr<FrameTransport>(new SharedMemoryTransport(prefix, slots)));
+    }
+
+    NetworkTransport::Settings network;
+    network.protocol = settings.get("NET_PROTOCOL", "udp") == "tcp" ? NetworkTransport::PROTOCOL_TCP : NetworkTransport::PROTOCOL_UDP;
+    network.host = settings.get("NET_IP", XML.getValue("SENDIP", "127.0.0.1"));
+    network.port = settings.getOwn("NET_PORT", XML.getValue("NET_PORT", 12340) + max(index, 0));
+    network.compress = settings.get("NET_COMPRESS", 1);
+    network.jpegQuality = settings.get("NET_JPEG_QUALITY", 80);
+    for (int stream : parseStreams(XML, "NET_STREAMS")) {
+        transports[stream].push_back(unique_ptr<FrameTransport>(new NetworkTransport(network)));
+    }
+}
+
+// the streams a comma separated setting names, leaving out any that are
+// not enabled
+vector<int> Sensor::parseStreams(ofxXmlSettings& XML, const string& setting)
+{
+    const bool enabled[STREAM_COUNT] = { hasColor, needsDepth(), hasIr, hasPoints, hasRegisteredColour };
+    vector<int> streams;
+    vector<string> names = ofSplitString(SensorSettings(XML, index).get(setting, ""), ",", true, true);
+    for (size_t i = 0; i < names.size(); i++) {
+        int stream = find(streamNames, streamNames + STREAM_COUNT, names[i]) - streamNames;
+        if (stream == STREAM_COUNT) {
+            ofLogWarning() << name << ": " << setting << ": unknown stream " << names[i];
+        }
+        else if (!enabled[stream]) {
+            ofLogWarning() << name << ": " << setting << ": " << names[i] << " is not enabled";
+        }
+        else {
+            streams.push_back(stream);
+        }
+    }
+    return streams;
+}
+
+bool Sensor::hasTransportClients(int stream) const
+{
+    for (const unique_ptr<FrameTransport>& transport : transports[stream]) {
+        if (transport->hasClients()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Sensor::publishTransports(const KinectFrame& frame, const ofFloatPixels& depth)
+{
+    ScopedTimer timer(stats.get(FrameStats::STAGE_PUBLISH_TRANSPORTS));
+    if (frame.color.isAllocated()) {
+        FrameTransportFormat::PixelFormat format = frame.color.getPixelFormat() == OF_PIXELS_BGRA ? FrameTransportFormat::PIXELS_BGRA8 : FrameTransportFormat::PIXELS_RGBA8;
+        publishTransport(STREAM_COLOUR, frame.color.getData(), frame.color.getWidth(), frame.color.getHeight(), format, frame);
+    }
+    if (depth.isAllocated()) {
+        publishTransport(STREAM_DEPTH, depth.getData(), depth.getWidth(), depth.getHeight(), FrameTransportFormat::PIXELS_FLOAT32, frame);
+    }
+    if (frame.ir.isAllocated()) {
+        publishTransport(STREAM_IR, frame.ir.getData(), frame.ir.getWidth(), frame.ir.getHeight(), FrameTransportFormat::PIXELS_FLOAT32, frame);
+    }
+    if (hasPoints) {
+        publishTransport(STREAM_POINTS, positionPixels.getData(), positionPixels.getWidth(), positionPixels.getHeight(), FrameTransportFormat::PIXELS_RGB32F, frame);
+    }
+    // registration is skipped while nobody watches, the buffer then holds an old frame
+    if (hasRegisteredColour && registeredColourConsumed && registeredColourPixels.isAllocated()) {
+        FrameTransportFormat::PixelFormat format = registeredColourPixels.getPixelFormat() == OF_PIXELS_BGRA ? FrameTransportFormat::PIXELS_BGRA8 : FrameTransportFormat::PIXELS_RGBA8;
+        publishTransport(STREAM_REGISTERED_COLOUR, registeredColourPixels.getData(), registeredColourPixels.getWidth(), registeredColourPixels.getHeight(), format, frame);
+    }
+}
+
+// transports are opened, or opened again, once the stream's format is known
+void Sensor::publishTransport(int stream, const void* pixels, int width, int height, FrameTransportFormat::PixelFormat format, const KinectFrame& frame)
+{
+    FrameFormat frameFormat;
+    frameFormat.width = width;
+    frameFormat.height = height;
+    frameFormat.pixelFormat = format;
+    vector<unique_ptr<FrameTransport>>& streamTransports = transports[stream];
+    for (size_t i = 0; i < streamTransports.size(); ) {
+        FrameTransport& transport = *streamTransports[i];
+        const FrameFormat& current = transport.getFormat();
+        if (!transport.isOpen() || current.width != frameFormat.width || current.height != frameFormat.height || current.pixelFormat != frameFormat.pixelFormat) {
+            if (!transport.open(streamNames[stream], frameFormat)) {
+                ofLogError() << name << ": could not open " << transport.getName() << ", not publishing it";
+                streamTransports.erase(streamTransports.begin() + i);
+                continue;
+            }
+            ofLogNotice() << name << ": publishing " << streamNames[stream] << " to " << transport.getName() << ", " << width << "x" << height << " " << FrameTransportFormat::getName(format);
+        }
+        if (transport.hasClients()) {
+            transport.publish(pixels, frame.sequence, frame.captureTime);
+        }
+        i++;
+    }
+}
+
+// a stream is worth converting when a Syphon client is attached or it is
+// visible in the preview
+bool Sensor::isConsumed(const SyphonOutput& output, bool previewed)
+{
+    return shared.alwaysUpload || output.hasClients() || (previewed && !shared.minimised);
+}
+
+void Sensor::startRecording(string name)
+{
+    if (name.empty()) {
+        name = "recording-" + ofGetTimestampString() + (index >= 0 ? "-" + ofToString(index) : "") + ".kv2";
+    }
+    // recordings are always full size colour
+    recorder.start(ofToDataPath(name), needsColor() && source->getColorScale() == 1, needsDepth(), hasIr, recordJpegQuality);
+    ofxOscMessage  myMessage;
+    myMessage.setAddress(oscPrefix + "/record");
+    myMessage.addIntArg(recorder.isRecording());
+    shared.sender->sendMessage(myMessage);
+}
+
+void Sensor::stopRecording()
+{
+    recorder.stop();
+    ofxOscMessage  myMessage;
+    myMessage.setAddress(oscPrefix + "/record");
+    myMessage.addIntArg(recorder.isRecording());
+    shared.sender->sendMessage(myMessage);
+}
+
+void Sensor::sendBackgroundState()
+{
+    ofxOscMessage  myMessage;
+    myMessage.setAddress(oscPrefix + "/background");
+    myMessage.addIntArg(background.isLearning());
+    myMessage.addIntArg(background.hasBackground());
+    shared.sender->sendMessage(myMessage);
+}
+
+// one bundle per frame: /blobs sequence count, then /blob index centroid x y,
+// box left top width height (all 0..1 of the depth image), area in pixels and
+// mean depth in mm for each blob
+void Sensor::sendBlobs(const KinectFrame& frame)
+{
+    const vector<BlobFinder::Blob>& blobs = blobFinder.getBlobs();
+    float width = blobMask.getWidth();
+    float height = blobMask.getHeight();
+
+    ofxOscBundle bundle;
+    ofxOscMessage header;
+    header.setAddress(oscPrefix + "/blobs");
+    header.addIntArg((int)frame.sequence);
+    header.addIntArg((int)blobs.size());
+    bundle.addMessage(header);
+
+    for (size_t i = 0; i < blobs.size(); i++) {
+        const BlobFinder::Blob& blob = blobs[i];
+        ofxOscMessage message;
+        message.setAddress(oscPrefix + "/blob");
+        message.addIntArg((int)i);
+        message.addFloatArg(blob.centroidX / width);
+        message.addFloatArg(blob.centroidY / height);
+        message.addFloatArg(blob.left / width);
+        message.addFloatArg(blob.top / height);
+        message.addFloatArg((blob.right - blob.left + 1) / width);
+        message.addFloatArg((blob.bottom - blob.top + 1) / height);
+        message.addIntArg(blob.area);
+        message.addFloatArg(blob.meanDepth);
+        bundle.addMessage(message);
+    }
+    shared.sender->sendBundle(bundle);
+}
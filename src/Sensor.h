@@ -0,0 +1,216 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SyphonOutput.h"
+#include "ofxXmlSettings.h"
+#include "ofxOsc.h"
+#include "CaptureThread.h"
+#include "FrameSource.h"
+#include "FrameTransport.h"
+#include "DepthFusion.h"
+#include "DepthMapping.h"
+#include "FrameStats.h"
+#include "Recorder.h"
+#include "BackgroundModel.h"
+#include "BlobFinder.h"
+#include "ColourScaler.h"
+#include "PointCloud.h"
+#include "Registration.h"
+#include "SpatialFilter.h"
+#include "TemporalFilter.h"
+#include "WorkerPool.h"
+
+// One Kinect, or a recording or synthetic scene standing in for it, and
+// everything made from its frames: a capture thread, the filters and
+// conversions, and its own set of Syphon servers, transports, background,
+// recorder and OSC messages. ofApp runs one per SENSOR in settings.xml, all
+// in one GL context on one thread, sharing the worker pool, the depth
+// mapping and its shaders, and the stats.
+//
+// A sensor's settings are the tags in its SENSOR block, falling back to the
+// top level ones, so settings.xml without a SENSORS list describes a single
+// sensor exactly as before.
+
+class Sensor {
+public:
+    // owned by ofApp, the same for every sensor
+    struct Shared {
+        bool headless = false;
+        bool cpuConversion = false;
+        bool alwaysUpload = false;
+        bool minimised = false;
+        // the depth of every frame goes on to fusion
+        bool fusion = false;
+        FrameStats* stats = nullptr;
+        WorkerPool* pool = nullptr;
+        DepthMapping* depthMapping = nullptr;
+        ofShader* depthShader = nullptr;
+        ofShader* irShader = nullptr;
+        ofTexture* depthLutTex = nullptr;
+        ofxOscSender* sender = nullptr;
+    };
+    
+    // streams that can go out through transports as well as Syphon
+    enum Stream {
+        STREAM_COLOUR,
+        STREAM_DEPTH,
+        STREAM_IR,
+        STREAM_POINTS,
+        STREAM_REGISTERED_COLOUR,
+        STREAM_COUNT
+    };
+    
+    explicit Sensor(const Shared& shared);
+    
+    // index is the sensor's SENSOR block, -1 when there is no SENSORS list
+    void setup(ofxXmlSettings& XML, int index);
+    // GL thread, returns true when a new frame was processed
+    bool update();
+    // publishes to Syphon and draws the preview row at y, unless minimised
+    void draw(float y);
+    void exit();
+    
+    // an OSC message for this sensor, address without any /sensor/<index>
+    void receive(const string& address, const ofxOscMessage& m);
+    void toggleFlip();
+    void learnBackground();
+    bool isRecording() const { return recorder.isRecording(); }
+    // name is relative to the data folder, empty picks a timestamped one
+    void startRecording(string name);
+    void stopRecording();
+    
+    const string& getName() const { return name; }
+    
+    // the filtered depth the newest frame was processed with, valid until
+    // the next update(), null before the first frame
+    const ofFloatPixels* getDepth() const { return processedDepth; }
+    const KinectFrame& getFrame() const { return capture.getFrame(); }
+    bool getFlip() const { return source->getFlip(); }
+    const PointCloud::Intrinsics& getIntrinsics() const { return calibration.depth; }
+    // where the sensor is in the world fusion merges into, POSE_* in settings.xml
+    const DepthFusion::Pose& getPose() const { return pose; }
+
+private:
+    bool isConsumed(const SyphonOutput& output, bool previewed);
+    void framePublished(const KinectFrame& frame);
+    void sendBackgroundState();
+    void sendBlobs(const KinectFrame& frame);
+    void setupTransports(ofxXmlSettings& XML);
+    vector<int> parseStreams(ofxXmlSettings& XML, const string& setting);
+    bool hasTransportClients(int stream) const;
+    void publishTransports(const KinectFrame& frame, const ofFloatPixels& depth);
+    void publishTransport(int stream, const void* pixels, int width, int height, FrameTransportFormat::PixelFormat format, const KinectFrame& frame);
+    bool needsColor() const { return hasColor || hasRegisteredColour || colourScaler.isActive(); }
+    bool needsDepth() const { return hasDepth || hasRawDepth || hasForeground || hasBlobs || hasPoints || hasRegisteredColour || hasColourDepth || shared.fusion; }
+    
+    const Shared& shared;
+    FrameStats& stats;
+    int index = -1;
+    // Syphon servers are called "<name> Colour" and so on
+    string name;
+    // "/sensor/<index>" on everything sent with a SENSORS list, empty without
+    string oscPrefix;
+    
+    unique_ptr<FrameSource> source;
+    CaptureThread capture;
+    uint64_t lastSequence = 0;
+    uint64_t publishedSequence = 0;
+    Recorder recorder;
+    int recordJpegQuality;
+    int openCLDevice;
+    bool flip;
+    ofTexture colorTex;
+    ofTexture depthTex;
+    ofTexture irTex;
+    SyphonOutput colourSyphon, depthSyphon, iRSyphon, rawDepthSyphon;
+    ofFbo irFbo, depthFbo;
+    bool hasColor, hasIr, hasDepth, hasRawDepth;
+    ofPixels rawDepthPixels;
+    ofTexture rawDepthTex;
+    
+    // with CPU conversion depth and IR are converted here, not in a shader
+    ofPixels depthPixels, irPixels;
+    
+    // streams nobody watches are neither converted nor uploaded
+    bool colorConsumed = true;
+    bool depthConsumed = true;
+    bool irConsumed = true;
+    bool rawDepthConsumed = true;
+    int colorSkipped = 0;
+    int depthSkipped = 0;
+    int irSkipped = 0;
+    int rawDepthSkipped = 0;
+    
+    // depth filters run on the GL thread, split over the worker pool
+    SpatialFilter spatialFilter;
+    ofFloatPixels spatialDepth;
+    bool temporalFiltering = false;
+    TemporalFilter temporalFilter;
+    ofFloatPixels filteredDepth;
+    const ofFloatPixels* processedDepth = nullptr;
+    DepthFusion::Pose pose;
+    
+    // foreground against a learned background, published packed like raw depth
+    bool hasForeground = false;
+    bool foregroundConsumed = true;
+    BackgroundModel background;
+    string backgroundFile;
+    int backgroundFrames;
+    SyphonOutput foregroundSyphon;
+    ofPixels foregroundPixels;
+    ofTexture foregroundTex;
+    
+    // blobs in the foreground mask, or in a depth range without a
+    // background, sent as one OSC bundle per frame
+    bool hasBlobs = false;
+    // whether the capture thread gets depth, fixed at setup
+    bool capturingDepth = false;
+    float blobNear, blobFar;
+    BlobFinder blobFinder;
+    ofPixels blobMask;
+    
+    // camera space positions in metres as an RGB32F texture for GL, and as
+    // int16 mm packed into RGBA8 for Syphon, which only carries 8 bits
+    bool hasPoints = false;
+    bool pointsConsumed = true;
+    PointCloud pointCloud;
+    ofFloatPixels positionPixels;
+    ofTexture positionTex;
+    ofPixels pointsPacked;
+    ofTexture pointsTex;
+    SyphonOutput pointsSyphon;
+    
+    // colour resampled onto the depth image, and depth splatted onto the
+    // colour image packed like raw depth. The mapping tables only change
+    // with the calibration or the flip
+    bool hasRegisteredColour = false;
+    bool hasColourDepth = false;
+    bool registeredColourConsumed = true;
+    bool colourDepthConsumed = true;
+    Registration registration;
+    Registration::Calibration calibration;
+    ofPixels registeredColourPixels;
+    ofTexture registeredColourTex;
+    SyphonOutput registeredColourSyphon;
+    ofFloatPixels colourDepth;
+    ofPixels colourDepthPixels;
+    ofTexture colourDepthTex;
+    SyphonOutput colourDepthSyphon;
+    
+    // smaller copies and a crop of the colour image, all made in one pass
+    // over it. Index i is the image divided by 2 << i
+    ColourScaler colourScaler;
+    bool scaledColourConsumed[ColourScaler::LEVELS] = { true, true, true };
+    ofPixels scaledColourPixels[ColourScaler::LEVELS];
+    ofTexture scaledColourTex[ColourScaler::LEVELS];
+    SyphonOutput scaledColourSyphon[ColourScaler::LEVELS];
+    bool roiColourConsumed = true;
+    ofPixels roiColourPixels;
+    ofTexture roiColourTex;
+    SyphonOutput roiColourSyphon;
+    
+    // streams published from memory rather than GL textures, to shared
+    // memory or the network, so they also work headless and away from
+    // macOS. Opened with the first frame
+    vector<unique_ptr<FrameTransport>> transports[STREAM_COUNT];
+};
@@ -0,0 +1,241 @@
+#include "SharedMemoryRing.h"
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace SharedMemoryRing;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the ring needs lock free 64 bit atomics to work across processes");
+
+namespace {
+
+    size_t padded(size_t size) {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    // every slot within the object and every frame within its slot, rows
+    // packed as getFormat() says
+    bool isValid(const Header& header, uint64_t size) {
+        FrameFormat format;
+        format.width = header.width;
+        format.height = header.height;
+        format.pixelFormat = (FrameTransportFormat::PixelFormat)header.pixelFormat;
+        uint64_t pixelsOffset = padded(sizeof(SlotHeader));
+        return header.slotCount > 0
+            && header.slotSize > pixelsOffset
+            && format.getStride() > 0 && header.stride == format.getStride()
+            && (uint64_t)header.stride * header.height <= header.slotSize - pixelsOffset
+            && header.firstSlot >= sizeof(Header) && header.firstSlot <= size
+            && header.slotCount <= (size - header.firstSlot) / header.slotSize;
+    }
+
+    SlotHeader* getSlot(Header* header, int slot) {
+        return (SlotHeader*)((unsigned char*)header + header->firstSlot + slot * header->slotSize);
+    }
+
+}
+
+std::string SharedMemoryRing::getObjectName(const std::string& prefix, const std::string& stream)
+{
+    return "/" + prefix + "-" + stream;
+}
+
+uint64_t SharedMemoryRing::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------
+
+Writer::~Writer()
+{
+    close();
+}
+
+bool Writer::open(const std::string& name, const FrameFormat& format, int slots)
+{
+    close();
+    // a writer that crashed leaves its object behind, readers still mapping
+    // it keep their copy until they notice nothing changes
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t slotSize = padded(sizeof(SlotHeader)) + padded(format.getSize());
+    size_t firstSlot = padded(sizeof(Header));
+    size_t total = firstSlot + slotSize * slots;
+    void* mapped = MAP_FAILED;
+    if (ftruncate(fd, total) == 0) {
+        mapped = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // the object starts zeroed, so every slot lock is 0 and every atomic
+    // is valid before the header is filled in
+    header = (Header*)mapped;
+    size = total;
+    this->name = name;
+    header->version = VERSION;
+    header->width = format.width;
+    header->height = format.height;
+    header->stride = format.getStride();
+    header->pixelFormat = format.pixelFormat;
+    header->slotCount = slots;
+    header->writerPid = getpid();
+    header->slotSize = slotSize;
+    header->firstSlot = firstSlot;
+    header->frameCount.store(0);
+    header->lastRead.store(0);
+    header->closed.store(0);
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+    return true;
+}
+
+void Writer::close()
+{
+    if (!header) {
+        return;
+    }
+    header->closed.store(1, std::memory_order_release);
+    munmap(header, size);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    size = 0;
+}
+
+void Writer::write(const void* pixels, uint64_t sequence, uint64_t timestamp)
+{
+    uint64_t n = header->frameCount.load(std::memory_order_relaxed);
+    SlotHeader* slot = getSlot(header, n % header->slotCount);
+
+    uint64_t lock = slot->lock.load(std::memory_order_relaxed);
+    slot->lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame = n;
+    slot->sequence = sequence;
+    slot->timestamp = timestamp;
+    memcpy((unsigned char*)slot + padded(sizeof(SlotHeader)), pixels, (size_t)header->stride * header->height);
+
+    slot->lock.store(lock + 2, std::memory_order_release);
+    header->frameCount.store(n + 1, std::memory_order_release);
+}
+
+uint64_t Writer::getTimeSinceRead() const
+{
+    uint64_t lastRead = header->lastRead.load(std::memory_order_relaxed);
+    if (!lastRead) {
+        return UINT64_MAX;
+    }
+    uint64_t time = now();
+    return time > lastRead ? time - lastRead : 0;
+}
+
+//--------------------------------------------------------------
+
+Reader::~Reader()
+{
+    close();
+}
+
+bool Reader::open(const std::string& name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(Header)) {
+        mapped = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    Header* candidate = (Header*)mapped;
+    bool valid = candidate->magic == MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && candidate->version == VERSION && isValid(*candidate, info.st_size);
+    if (!valid) {
+        // not a ring, or the writer is still setting it up
+        munmap(mapped, info.st_size);
+        return false;
+    }
+    header = candidate;
+    size = info.st_size;
+    return true;
+}
+
+void Reader::close()
+{
+    if (header) {
+        munmap(header, size);
+        header = nullptr;
+        size = 0;
+    }
+}
+
+bool Reader::isWriterClosed() const
+{
+    return header->closed.load(std::memory_order_acquire) != 0;
+}
+
+FrameFormat Reader::getFormat() const
+{
+    FrameFormat format;
+    format.width = header->width;
+    format.height = header->height;
+    format.pixelFormat = (FrameTransportFormat::PixelFormat)header->pixelFormat;
+    return format;
+}
+
+uint64_t Reader::getFrameCount() const
+{
+    return header->frameCount.load(std::memory_order_acquire);
+}
+
+bool Reader::acquire(Frame& frame)
+{
+    uint64_t count = getFrameCount();
+    return count && acquire(count - 1, frame);
+}
+
+bool Reader::acquire(uint64_t n, Frame& frame)
+{
+    header->lastRead.store(now(), std::memory_order_relaxed);
+    int index = n % header->slotCount;
+    SlotHeader* slot = getSlot(header, index);
+    uint64_t lock = slot->lock.load(std::memory_order_acquire);
+    if (lock & 1) {
+        return false;
+    }
+    frame.frame = slot->frame;
+    frame.sequence = slot->sequence;
+    frame.timestamp = slot->timestamp;
+    frame.pixels = (const unsigned char*)slot + padded(sizeof(SlotHeader));
+    frame.lock = lock;
+    frame.slot = index;
+    // a slot that was rewritten before the fields were read is no good
+    return frame.frame == n && release(frame);
+}
+
+bool Reader::release(const Frame& frame)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return getSlot(header, frame.slot)->lock.load(std::memory_order_relaxed) == frame.lock;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "FrameTransport.h"
+
+// Frames in a POSIX shared memory object, for any number of local readers
+// without a copy per reader.
+//
+//   Header
+//   slot: SlotHeader, pixels
+//   slot ...
+//
+// The writer fills slot n % slotCount with frame n and never waits for
+// readers. Each slot is guarded by a seqlock: its sequence is odd while the
+// writer is inside and goes up by two for each frame written. A reader
+// looks at the pixels in place and afterwards checks the sequence it saw
+// is unchanged; if not, the writer lapped it and the frame is torn. With
+// three slots a reader has two frame periods to finish with a frame.
+//
+// Readers stamp lastRead so the writer can tell whether anyone is
+// listening. The writer removes the object when it closes and sets closed,
+// so a reader knows to open it again once a new writer is up. Every header
+// and slot starts on a 64 byte boundary, the atomics are 64 bit and lock
+// free on every platform the app runs on.
+
+namespace SharedMemoryRing {
+
+    const uint32_t MAGIC = 0x5332564b; // "KV2S"
+    const uint32_t VERSION = 1;
+    const size_t ALIGNMENT = 64;
+    
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        uint32_t pixelFormat;  // FrameTransportFormat::PixelFormat
+        uint32_t slotCount;
+        uint32_t writerPid;
+        uint64_t slotSize;     // SlotHeader and pixels, offset to the next slot
+        uint64_t firstSlot;    // offset of slot 0
+        // frames written, the newest is frameCount - 1
+        std::atomic<uint64_t> frameCount;
+        // steady clock ns of the last read, written by readers
+        std::atomic<uint64_t> lastRead;
+        std::atomic<uint32_t> closed;
+    };
+    
+    struct alignas(64) SlotHeader {
+        std::atomic<uint64_t> lock;  // odd while being written
+        uint64_t frame;              // frame number within the ring
+        uint64_t sequence;           // capture sequence
+        uint64_t timestamp;          // capture time, steady clock ns
+    };
+    
+    // "/kinectv2-colour" style names, at most 31 characters on macOS
+    std::string getObjectName(const std::string& prefix, const std::string& stream);
+    uint64_t now();
+    
+    class Writer {
+    public:
+        ~Writer();
+        
+        bool open(const std::string& name, const FrameFormat& format, int slots);
+        void close();
+        bool isOpen() const { return header != nullptr; }
+        
+        void write(const void* pixels, uint64_t sequence, uint64_t timestamp);
+        // steady clock ns since a reader last read, UINT64_MAX if none ever did
+        uint64_t getTimeSinceRead() const;
+    
+    private:
+        std::string name;
+        Header* header = nullptr;
+        size_t size = 0;
+    };
+    
+    // a frame in the ring, valid to look at until Reader::release()
+    struct Frame {
+        const unsigned char* pixels = nullptr;
+        uint64_t frame = 0;
+        uint64_t sequence = 0;
+        uint64_t timestamp = 0;
+        uint64_t lock = 0;
+        int slot = -1;
+    };
+    
+    class Reader {
+    public:
+        ~Reader();
+        
+        bool open(const std::string& name);
+        void close();
+        bool isOpen() const { return header != nullptr; }
+        // the writer has gone, open again to follow the next one
+        bool isWriterClosed() const;
+        FrameFormat getFormat() const;
+        uint64_t getFrameCount() const;
+        
+        // the newest complete frame, false if there is none yet or the writer
+        // was writing it
+        bool acquire(Frame& frame);
+        // frame number n if it is still in the ring
+        bool acquire(uint64_t n, Frame& frame);
+        // true if the frame was not overwritten while it was being used
+        bool release(const Frame& frame);
+    
+    private:
+        Header* header = nullptr;
+        size_t size = 0;
+    };
+
+}
@@ -0,0 +1,32 @@
+#include "SharedMemoryTransport.h"
+
+namespace {
+    const uint64_t CLIENT_TIMEOUT = 1000000000;
+}
+
+SharedMemoryTransport::SharedMemoryTransport(const std::string& prefix, int slots)
+: prefix(prefix), slots(slots < 2 ? 2 : slots)
+{
+}
+
+bool SharedMemoryTransport::open(const std::string& stream, const FrameFormat& format)
+{
+    name = SharedMemoryRing::getObjectName(prefix, stream);
+    this->format = format;
+    return ring.open(name, format, slots);
+}
+
+void SharedMemoryTransport::close()
+{
+    ring.close();
+}
+
+bool SharedMemoryTransport::hasClients() const
+{
+    return ring.isOpen() && ring.getTimeSinceRead() < CLIENT_TIMEOUT;
+}
+
+void SharedMemoryTransport::publish(const void* pixels, uint64_t sequence, uint64_t timestamp)
+{
+    ring.write(pixels, sequence, timestamp);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "FrameTransport.h"
+#include "SharedMemoryRing.h"
+
+// Publishes a stream into a SharedMemoryRing named "/<prefix>-<stream>".
+// Readers map the ring and look at frames in place, see tools/kinectshm.
+
+class SharedMemoryTransport : public FrameTransport {
+public:
+    SharedMemoryTransport(const std::string& prefix, int slots);
+    
+    bool open(const std::string& stream, const FrameFormat& format);
+    void close();
+    bool isOpen() const { return ring.isOpen(); }
+    const FrameFormat& getFormat() const { return format; }
+    // a reader looked at the ring within the last second
+    bool hasClients() const;
+    void publish(const void* pixels, uint64_t sequence, uint64_t timestamp);
+    std::string getName() const { return name; }
+
+private:
+    std::string prefix;
+    int slots;
+    std::string name;
+    FrameFormat format;
+    SharedMemoryRing::Writer ring;
+};
@@ -0,0 +1,358 @@
+#include "SpatialFilter.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    // 4 pixels at a time where there is SIMD, the tail and other builds use
+    // the same networks on single floats
+#if defined(__SSE2__)
+    typedef __m128 Lanes;
+    const int LANES = 4;
+    inline Lanes load(const float* p, Lanes) { return _mm_loadu_ps(p); }
+    inline void store(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+    inline Lanes minimum(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+    inline Lanes maximum(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+#elif defined(__ARM_NEON)
+    typedef float32x4_t Lanes;
+    const int LANES = 4;
+    inline Lanes load(const float* p, Lanes) { return vld1q_f32(p); }
+    inline void store(float* p, Lanes v) { vst1q_f32(p, v); }
+    inline Lanes minimum(Lanes a, Lanes b) { return vminq_f32(a, b); }
+    inline Lanes maximum(Lanes a, Lanes b) { return vmaxq_f32(a, b); }
+#else
+    typedef float Lanes;
+    const int LANES = 1;
+#endif
+
+    inline float load(const float* p, float) { return *p; }
+    inline void store(float* p, float v) { *p = v; }
+    inline float minimum(float a, float b) { return a < b ? a : b; }
+    inline float maximum(float a, float b) { return a < b ? b : a; }
+
+    // selection networks (Paeth, Devillard), only the median ends up sorted
+#define MEDIAN9_NETWORK \
+    S(1, 2) S(4, 5) S(7, 8) S(0, 1) S(3, 4) S(6, 7) S(1, 2) S(4, 5) S(7, 8) \
+    S(0, 3) S(5, 8) S(4, 7) S(3, 6) S(1, 4) S(2, 5) S(4, 7) S(4, 2) S(6, 4) \
+    S(4, 2)
+
+#define MEDIAN25_NETWORK \
+    S(0, 1) S(3, 4) S(2, 4) S(2, 3) S(6, 7) S(5, 7) S(5, 6) S(9, 10) S(8, 10) \
+    S(8, 9) S(12, 13) S(11, 13) S(11, 12) S(15, 16) S(14, 16) S(14, 15) S(18, 19) S(17, 19) \
+    S(17, 18) S(21, 22) S(20, 22) S(20, 21) S(23, 24) S(2, 5) S(3, 6) S(0, 6) S(0, 3) \
+    S(4, 7) S(1, 7) S(1, 4) S(11, 14) S(8, 14) S(8, 11) S(12, 15) S(9, 15) S(9, 12) \
+    S(13, 16) S(10, 16) S(10, 13) S(20, 23) S(17, 23) S(17, 20) S(21, 24) S(18, 24) S(18, 21) \
+    S(19, 22) S(8, 17) S(9, 18) S(0, 18) S(0, 9) S(10, 19) S(1, 19) S(1, 10) S(11, 20) \
+    S(2, 20) S(2, 11) S(12, 21) S(3, 21) S(3, 12) S(13, 22) S(4, 22) S(4, 13) S(14, 23) \
+    S(5, 23) S(5, 14) S(15, 24) S(6, 24) S(6, 15) S(7, 16) S(7, 19) S(13, 21) S(15, 23) \
+    S(7, 13) S(7, 15) S(1, 9) S(3, 11) S(5, 17) S(11, 17) S(9, 17) S(4, 10) S(6, 12) \
+    S(7, 14) S(4, 6) S(4, 7) S(12, 14) S(10, 14) S(6, 7) S(10, 12) S(6, 10) S(6, 17) \
+    S(12, 17) S(7, 17) S(7, 10) S(12, 18) S(7, 12) S(10, 18) S(12, 20) S(10, 20) S(10, 12)
+
+#define S(a, b) { V low = minimum(p[a], p[b]); p[b] = maximum(p[a], p[b]); p[a] = low; }
+
+    // one output pixel (or LANES of them) at in, rows are stride apart
+    template<typename V>
+    inline V median3At(const float* in, int stride) {
+        V p[9];
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = 0; dx < 3; dx++) {
+                p[dy * 3 + dx] = load(in + (dy - 1) * stride + dx - 1, V());
+            }
+        }
+        MEDIAN9_NETWORK
+        return p[4];
+    }
+
+    template<typename V>
+    inline V median5At(const float* in, int stride) {
+        V p[25];
+        for (int dy = 0; dy < 5; dy++) {
+            for (int dx = 0; dx < 5; dx++) {
+                p[dy * 5 + dx] = load(in + (dy - 2) * stride + dx - 2, V());
+            }
+        }
+        MEDIAN25_NETWORK
+        return p[12];
+    }
+
+#undef S
+
+}
+
+//--------------------------------------------------------------
+std::string SpatialFilter::getFilterName(Type type)
+{
+    switch (type) {
+        case FILTER_MEDIAN3: return "median3";
+        case FILTER_MEDIAN5: return "median5";
+        case FILTER_BILATERAL: return "bilateral";
+        case FILTER_FILL: return "fill";
+        default: return "unknown";
+    }
+}
+
+bool SpatialFilter::parseFilter(const std::string& name, Type& type)
+{
+    for (int i = 0; i < FILTER_COUNT; i++) {
+        if (getFilterName((Type)i) == name) {
+            type = (Type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SpatialFilter::setup(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    paddedWidth = width + 2 * BORDER;
+    padded.assign(paddedWidth * (height + 2 * BORDER), 0.0f);
+    paddedGuide.assign(padded.size(), 0.0f);
+    planes[0].assign(width * height, 0.0f);
+    planes[1].assign(width * height, 0.0f);
+    weights.assign(width * height, 0.0f);
+    updateSpatialWeights();
+}
+
+bool SpatialFilter::setChain(const std::string& chain)
+{
+    order.clear();
+    std::fill(enabled, enabled + FILTER_COUNT, false);
+
+    bool known = true;
+    std::stringstream names(chain);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        Type type;
+        if (name.empty()) {
+            continue;
+        }
+        if (!parseFilter(name, type)) {
+            known = false;
+            continue;
+        }
+        setEnabled(type, true);
+    }
+    return known;
+}
+
+std::string SpatialFilter::getChain() const
+{
+    std::string chain;
+    for (Type type : order) {
+        if (enabled[type]) {
+            chain += (chain.empty() ? "" : ",") + getFilterName(type);
+        }
+    }
+    return chain;
+}
+
+void SpatialFilter::setEnabled(Type type, bool enabled)
+{
+    if (enabled && std::find(order.begin(), order.end(), type) == order.end()) {
+        order.push_back(type);
+    }
+    this->enabled[type] = enabled;
+}
+
+bool SpatialFilter::isEnabled(Type type) const
+{
+    return enabled[type];
+}
+
+bool SpatialFilter::isActive() const
+{
+    return std::find(enabled, enabled + FILTER_COUNT, true) != enabled + FILTER_COUNT;
+}
+
+void SpatialFilter::setBilateralRadius(int radius)
+{
+    bilateralRadius = std::min(std::max(radius, 1), (int)MAX_RADIUS);
+    updateSpatialWeights();
+}
+
+void SpatialFilter::setBilateralSigmas(float space, float irRange, float depthRange)
+{
+    spaceSigma = space;
+    irRangeSigma = irRange;
+    depthRangeSigma = depthRange;
+    updateSpatialWeights();
+}
+
+void SpatialFilter::updateSpatialWeights()
+{
+    int size = 2 * bilateralRadius + 1;
+    spatialWeights.resize(size * size);
+    for (int dy = -bilateralRadius; dy <= bilateralRadius; dy++) {
+        for (int dx = -bilateralRadius; dx <= bilateralRadius; dx++) {
+            spatialWeights[(dy + bilateralRadius) * size + dx + bilateralRadius] = std::exp(-(dx * dx + dy * dy) / (2.0f * spaceSigma * spaceSigma));
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void SpatialFilter::forRows(int rows, WorkerPool* pool, const std::function<void(size_t, size_t)>& task)
+{
+    if (pool) {
+        pool->parallelFor(rows, task, 8);
+    }
+    else {
+        task(0, rows);
+    }
+}
+
+void SpatialFilter::pad(const float* plane, float* padded, WorkerPool* pool)
+{
+    forRows(height + 2 * BORDER, pool, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            int y = std::min(std::max((int)row - BORDER, 0), height - 1);
+            const float* in = plane + y * width;
+            float* out = padded + row * paddedWidth;
+            std::fill(out, out + BORDER, in[0]);
+            memcpy(out + BORDER, in, width * sizeof(float));
+            std::fill(out + BORDER + width, out + paddedWidth, in[width - 1]);
+        }
+    });
+}
+
+void SpatialFilter::apply(const float* depth, const float* ir, float* filtered, WorkerPool* pool)
+{
+    const float* current = depth;
+    int next = 0;
+
+    bool guided = ir && enabled[FILTER_BILATERAL];
+    if (guided) {
+        pad(ir, paddedGuide.data(), pool);
+    }
+
+    for (Type type : order) {
+        if (!enabled[type]) {
+            continue;
+        }
+        int passes = type == FILTER_FILL ? fillIterations : 1;
+        for (int pass = 0; pass < passes; pass++) {
+            float* out = planes[next].data();
+            pad(current, padded.data(), pool);
+            forRows(height, pool, [&](size_t y0, size_t y1) {
+                switch (type) {
+                    case FILTER_MEDIAN3: median3(out, y0, y1); break;
+                    case FILTER_MEDIAN5: median5(out, y0, y1); break;
+                    case FILTER_BILATERAL: bilateral(out, guided, y0, y1); break;
+                    case FILTER_FILL: fill(out, y0, y1); break;
+                    default: break;
+                }
+            });
+            current = out;
+            next = 1 - next;
+        }
+    }
+
+    memcpy(filtered, current, width * height * sizeof(float));
+}
+
+void SpatialFilter::median3(float* out, int y0, int y1)
+{
+    for (int y = y0; y < y1; y++) {
+        const float* in = padded.data() + (y + BORDER) * paddedWidth + BORDER;
+        float* row = out + y * width;
+        int x = 0;
+        for (; x + LANES <= width; x += LANES) {
+            store(row + x, median3At<Lanes>(in + x, paddedWidth));
+        }
+        for (; x < width; x++) {
+            row[x] = median3At<float>(in + x, paddedWidth);
+        }
+    }
+}
+
+void SpatialFilter::median5(float* out, int y0, int y1)
+{
+    for (int y = y0; y < y1; y++) {
+        const float* in = padded.data() + (y + BORDER) * paddedWidth + BORDER;
+        float* row = out + y * width;
+        int x = 0;
+        for (; x + LANES <= width; x += LANES) {
+            store(row + x, median5At<Lanes>(in + x, paddedWidth));
+        }
+        for (; x < width; x++) {
+            row[x] = median5At<float>(in + x, paddedWidth);
+        }
+    }
+}
+
+void SpatialFilter::bilateral(float* out, bool guided, int y0, int y1)
+{
+    const float* guide = guided ? paddedGuide.data() : padded.data();
+    int radius = bilateralRadius;
+    int size = 2 * radius + 1;
+    // range weight (1 - d^2 / 9 sigma^2)^2, a smooth bump that falls to 0 at
+    // 3 sigma like a truncated gaussian, but only multiplies so the compiler
+    // vectorises it along the row
+    float rangeSigma = guided ? irRangeSigma : depthRangeSigma;
+    float rangeFactor = 1.0f / (9.0f * rangeSigma * rangeSigma);
+    
+    for (int y = y0; y < y1; y++) {
+        const float* in = padded.data() + (y + BORDER) * paddedWidth + BORDER;
+        const float* centre = guide + (y + BORDER) * paddedWidth + BORDER;
+        float* row = out + y * width;
+        float* totals = weights.data() + y * width;
+        std::fill(row, row + width, 0.0f);
+        std::fill(totals, totals + width, 0.0f);
+        
+        // one tap at a time across the whole row
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                float spatial = spatialWeights[(dy + radius) * size + dx + radius];
+                const float* depthTap = in + dy * paddedWidth + dx;
+                const float* guideTap = centre + dy * paddedWidth + dx;
+                float* sums = row;
+                for (int x = 0; x < width; x++) {
+                    float value = depthTap[x];
+                    float difference = guideTap[x] - centre[x];
+                    float falloff = std::max(1.0f - difference * difference * rangeFactor, 0.0f);
+                    float weight = (value > 0 ? spatial : 0.0f) * falloff * falloff;
+                    sums[x] += weight * value;
+                    totals[x] += weight;
+                }
+            }
+        }
+        
+        for (int x = 0; x < width; x++) {
+            // without IR a hole has nothing to be guided by and stays a hole
+            bool keep = totals[x] > 0 && (guided || in[x] > 0);
+            row[x] = keep ? row[x] / totals[x] : 0.0f;
+        }
+    }
+}
+
+void SpatialFilter::fill(float* out, int y0, int y1)
+{
+    for (int y = y0; y < y1; y++) {
+        const float* in = padded.data() + (y + BORDER) * paddedWidth + BORDER;
+        float* row = out + y * width;
+        for (int x = 0; x < width; x++) {
+            float value = in[x];
+            if (value <= 0) {
+                const float* p = in + x;
+                int stride = paddedWidth;
+                value = maximum(maximum(maximum(p[-stride - 1], p[-stride]), maximum(p[-stride + 1], p[-1])),
+                                maximum(maximum(p[1], p[stride - 1]), maximum(p[stride], p[stride + 1])));
+            }
+            row[x] = value;
+        }
+    }
+}
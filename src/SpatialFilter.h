@@ -0,0 +1,93 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+// Chain of spatial depth filters, run in a configurable order:
+//
+//   median3, median5  median of the 3x3 / 5x5 neighbourhood, removes flying
+//                     pixels and single pixel holes
+//   bilateral         edge preserving smoothing. With an IR frame it is a
+//                     joint bilateral filter, weights follow the IR image so
+//                     edges stay where the IR edges are and holes are filled
+//                     from neighbours on the same surface
+//   fill              morphological hole fill, a hole takes the farthest
+//                     valid neighbour since the Kinect's edge shadows fall on
+//                     the background side. Repeated fillIterations times
+//
+// Each filter reads a copy of its input with a replicated border, so the
+// kernels never check bounds, and writes rows in bands spread over the
+// worker pool; a band of 512 pixel rows plus the window fits in L1. The
+// medians use SSE2 or NEON min/max sorting networks, 4 pixels at a time.
+
+class SpatialFilter {
+public:
+    enum Type {
+        FILTER_MEDIAN3,
+        FILTER_MEDIAN5,
+        FILTER_BILATERAL,
+        FILTER_FILL,
+        FILTER_COUNT
+    };
+
+    static const int BORDER = 4;
+    static const int MAX_RADIUS = BORDER;
+
+    static std::string getFilterName(Type type);
+    static bool parseFilter(const std::string& name, Type& type);
+
+    void setup(int width, int height);
+
+    // comma separated filter names in the order they run, replaces the
+    // current chain. Returns false if a name is unknown, the others are kept
+    bool setChain(const std::string& chain);
+    // the enabled filters in order
+    std::string getChain() const;
+
+    // enabling a filter that is not in the chain appends it
+    void setEnabled(Type type, bool enabled);
+    bool isEnabled(Type type) const;
+    bool isActive() const;
+
+    void setBilateralRadius(int radius);
+    // spatial sigma in pixels, range sigmas in IR units for when IR guides
+    // the filter and in mm for when depth guides itself
+    void setBilateralSigmas(float space, float irRange, float depthRange);
+    void setFillIterations(int iterations) { fillIterations = iterations; }
+
+    // filtered must not alias depth, ir may be null, pool may be null to run
+    // on the calling thread
+    void apply(const float* depth, const float* ir, float* filtered, WorkerPool* pool);
+
+private:
+    void forRows(int rows, WorkerPool* pool, const std::function<void(size_t, size_t)>& task);
+    void pad(const float* plane, float* padded, WorkerPool* pool);
+    void median3(float* out, int y0, int y1);
+    void median5(float* out, int y0, int y1);
+    void bilateral(float* out, bool guided, int y0, int y1);
+    void fill(float* out, int y0, int y1);
+    void updateSpatialWeights();
+
+    int width = 0;
+    int height = 0;
+    int paddedWidth = 0;
+
+    std::vector<Type> order;
+    bool enabled[FILTER_COUNT] = {};
+
+    int bilateralRadius = 2;
+    float spaceSigma = 1.5f;
+    float irRangeSigma = 2000.0f;
+    float depthRangeSigma = 40.0f;
+    std::vector<float> spatialWeights;
+    int fillIterations = 2;
+
+    std::vector<float> padded;
+    std::vector<float> paddedGuide;
+    std::vector<float> planes[2];
+    // the bilateral filter's weight sums, one per pixel so bands don't share
+    std::vector<float> weights;
+};
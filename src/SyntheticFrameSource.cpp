@@ -0,0 +1,47 @@
+#include "SyntheticFrameSource.h"
+
+SyntheticFrameSource::SyntheticFrameSource(const SyntheticScene::Settings& settings, float fps)
+: scene(settings)
+, fps(fps)
+{
+}
+
+bool SyntheticFrameSource::open(bool hasColor, bool hasDepth, bool hasIr)
+{
+    this->hasColor = hasColor;
+    this->hasDepth = hasDepth;
+    this->hasIr = hasIr;
+    frameNumber = 0;
+    start = chrono::steady_clock::now();
+    return true;
+}
+
+void SyntheticFrameSource::close()
+{
+}
+
+bool SyntheticFrameSource::waitForFrame()
+{
+    this_thread::sleep_until(start + chrono::nanoseconds((uint64_t)(frameNumber * 1e9 / fps)));
+    return true;
+}
+
+void SyntheticFrameSource::readFrame(KinectFrame& frame)
+{
+    // IR is derived from depth, so depth is rendered for either
+    if (hasDepth || hasIr) {
+        scene.renderDepth(frameNumber, frame.depth.getData());
+    }
+    if (hasIr) {
+        scene.renderIr(frame.depth.getData(), frame.ir.getData());
+    }
+    if (hasColor) {
+        scene.renderColor(frameNumber, frame.color.getData());
+    }
+    frameNumber++;
+}
+
+string SyntheticFrameSource::getName() const
+{
+    return "synthetic";
+}
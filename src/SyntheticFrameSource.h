@@ -0,0 +1,29 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "SyntheticScene.h"
+
+// Renders a SyntheticScene at a fixed frame rate.
+
+class SyntheticFrameSource : public FrameSource {
+public:
+    SyntheticFrameSource(const SyntheticScene::Settings& settings, float fps);
+    
+    bool open(bool hasColor, bool hasDepth, bool hasIr);
+    void close();
+    
+    bool waitForFrame();
+    void readFrame(KinectFrame& frame);
+    
+    string getName() const;
+    
+private:
+    SyntheticScene scene;
+    float fps;
+    bool hasColor = false;
+    bool hasDepth = false;
+    bool hasIr = false;
+    
+    uint64_t frameNumber = 0;
+    chrono::steady_clock::time_point start;
+};
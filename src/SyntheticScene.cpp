@@ -0,0 +1,117 @@
+#include "SyntheticScene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    
+    // xorshift32, fast and the same everywhere unlike the std distributions
+    inline uint32_t nextRandom(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    
+    inline float nextUnit(uint32_t& state) {
+        return (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+    }
+    
+}
+
+SyntheticScene::SyntheticScene()
+: SyntheticScene(Settings())
+{
+}
+
+SyntheticScene::SyntheticScene(const Settings& settings)
+: settings(settings)
+, background(DEPTH_WIDTH * DEPTH_HEIGHT)
+{
+    // wall at 4.5 m, the bottom rows are a floor coming towards the sensor
+    for (int y = 0; y < DEPTH_HEIGHT; y++) {
+        float depth = y < 300 ? 4500.0f : 4500.0f - (y - 300) * 25.0f;
+        std::fill(background.begin() + y * DEPTH_WIDTH, background.begin() + (y + 1) * DEPTH_WIDTH, depth);
+    }
+}
+
+void SyntheticScene::getPlanes(uint64_t frame, std::vector<Plane>& planes) const
+{
+    int count = std::min(std::max(settings.planes, 0), (int)MAX_PLANES);
+    planes.resize(count);
+    for (int i = 0; i < count; i++) {
+        float t = frame / 30.0f;
+        float phase = i * 2.1f;
+        Plane& plane = planes[i];
+        // within the image, so x and y below stay in it too
+        plane.width = std::min(60 + 30 * i, (int)DEPTH_WIDTH);
+        plane.height = std::min(120 + 20 * i, (int)DEPTH_HEIGHT);
+        plane.x = (int)((DEPTH_WIDTH - plane.width) * (0.5f + 0.45f * std::sin(t * (0.4f + 0.15f * i) + phase)));
+        plane.y = (int)((DEPTH_HEIGHT - plane.height) * (0.5f + 0.3f * std::sin(t * 0.23f + phase)));
+        plane.depth = 2250.0f + 1250.0f * std::cos(t * (0.3f + 0.1f * i) + phase);
+        plane.color = 0xff000000 | ((0x40 + 0x50 * i) & 0xff) << 16 | 0x8000 | (0xc0 - 0x30 * i);
+    }
+}
+
+void SyntheticScene::renderDepth(uint64_t frame, float* depth) const
+{
+    memcpy(depth, background.data(), background.size() * sizeof(float));
+    
+    std::vector<Plane> planes;
+    getPlanes(frame, planes);
+    for (const Plane& plane : planes) {
+        for (int y = plane.y; y < plane.y + plane.height; y++) {
+            float* row = depth + y * DEPTH_WIDTH;
+            for (int x = plane.x; x < plane.x + plane.width; x++) {
+                row[x] = std::min(row[x], plane.depth);
+            }
+            // the sensor sees no return along the left edge of near objects
+            row[plane.x] = 0;
+        }
+    }
+    
+    // sum of two uniforms is triangular, scaled to the requested deviation
+    uint32_t state = settings.seed ^ (uint32_t)(frame * 2654435761u) ^ 0x9e3779b9;
+    state = state ? state : 1;
+    float noiseScale = settings.noise * std::sqrt(6.0f);
+    for (int i = 0; i < DEPTH_WIDTH * DEPTH_HEIGHT; i++) {
+        if (nextUnit(state) < settings.holes) {
+            depth[i] = 0;
+        }
+        else if (depth[i] > 0) {
+            depth[i] = std::floor(depth[i] + (nextUnit(state) + nextUnit(state) - 1.0f) * noiseScale);
+        }
+    }
+}
+
+void SyntheticScene::renderIr(const float* depth, float* ir) const
+{
+    for (int i = 0; i < DEPTH_WIDTH * DEPTH_HEIGHT; i++) {
+        ir[i] = depth[i] > 0 ? std::min(4e10f / (depth[i] * depth[i]), 65535.0f) : 0.0f;
+    }
+}
+
+void SyntheticScene::renderColor(uint64_t frame, unsigned char* rgba) const
+{
+    uint32_t* pixels = (uint32_t*)rgba;
+    for (int y = 0; y < COLOR_HEIGHT; y++) {
+        uint32_t shade = (uint32_t)(y * 160 / COLOR_HEIGHT + 40);
+        uint32_t color = 0xff000000 | shade << 16 | shade << 8 | shade;
+        std::fill(pixels + y * COLOR_WIDTH, pixels + (y + 1) * COLOR_WIDTH, color);
+    }
+    
+    // the colour camera sees roughly the same view, scaled up
+    std::vector<Plane> planes;
+    getPlanes(frame, planes);
+    std::sort(planes.begin(), planes.end(), [](const Plane& a, const Plane& b) { return a.depth > b.depth; });
+    for (const Plane& plane : planes) {
+        int x0 = plane.x * COLOR_WIDTH / DEPTH_WIDTH;
+        int x1 = (plane.x + plane.width) * COLOR_WIDTH / DEPTH_WIDTH;
+        int y0 = plane.y * COLOR_HEIGHT / DEPTH_HEIGHT;
+        int y1 = (plane.y + plane.height) * COLOR_HEIGHT / DEPTH_HEIGHT;
+        for (int y = y0; y < y1; y++) {
+            std::fill(pixels + y * COLOR_WIDTH + x0, pixels + y * COLOR_WIDTH + x1, plane.color);
+        }
+    }
+}
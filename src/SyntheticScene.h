@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Deterministic stand-in for the Kinect: a back wall and floor with a few
+// rectangular planes moving in front of them, per-pixel depth noise, random
+// holes and the zeroed column the sensor leaves at the left edge of near
+// objects. Everything is a function of the frame number and seed, so frame N
+// is identical on every run and every machine.
+
+class SyntheticScene {
+public:
+    struct Settings {
+        int planes = 3;         // 0 to MAX_PLANES
+        float noise = 4.0f;     // standard deviation in mm
+        float holes = 0.01f;    // fraction of pixels with no depth
+        uint32_t seed = 1;
+    };
+    
+    static const int DEPTH_WIDTH = 512;
+    static const int DEPTH_HEIGHT = 424;
+    static const int COLOR_WIDTH = 1920;
+    static const int COLOR_HEIGHT = 1080;
+    // the planes grow with their index, past this they would not fit
+    static const int MAX_PLANES = 16;
+    
+    SyntheticScene();
+    explicit SyntheticScene(const Settings& settings);
+    
+    // millimetres, DEPTH_WIDTH * DEPTH_HEIGHT floats
+    void renderDepth(uint64_t frame, float* depth) const;
+    // IR falling off with distance, 0 where depth has holes
+    void renderIr(const float* depth, float* ir) const;
+    // RGBA, COLOR_WIDTH * COLOR_HEIGHT * 4 bytes
+    void renderColor(uint64_t frame, unsigned char* rgba) const;
+    
+private:
+    struct Plane {
+        int x, y, width, height;
+        float depth;
+        uint32_t color;
+    };
+    
+    void getPlanes(uint64_t frame, std::vector<Plane>& planes) const;
+    
+    Settings settings;
+    std::vector<float> background;
+};
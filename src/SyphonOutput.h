@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef TARGET_OSX
+
+#include "ofxSyphon.h"
+
+// ofxSyphonServer that can tell whether anyone is listening, so the app can
+// skip converting and uploading frames for streams with no clients.
+
+class SyphonOutput : public ofxSyphonServer {
+public:
+    // true while at least one Syphon client is attached to this server
+    bool hasClients() const;
+};
+
+#else
+
+#include "ofMain.h"
+
+// Syphon only exists on macOS. Elsewhere the outputs are there but publish
+// nothing and never have clients, streams go out through SHM_STREAMS.
+
+class SyphonOutput {
+public:
+    void setName(string name) {}
+    void publishTexture(ofTexture* texture) {}
+    bool hasClients() const { return false; }
+};
+
+#endif
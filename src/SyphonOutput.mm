@@ -0,0 +1,8 @@
+#include "SyphonOutput.h"
+
+#import <Syphon/Syphon.h>
+
+bool SyphonOutput::hasClients() const
+{
+    return mSyphon != nil && [(SyphonServer *)mSyphon hasClients];
+}
@@ -0,0 +1,62 @@
+#include "TemporalFilter.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TemporalFilter::setup(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    smoothed.assign(width * height, 0.0f);
+    age.assign(width * height, 0);
+}
+
+void TemporalFilter::reset()
+{
+    std::fill(smoothed.begin(), smoothed.end(), 0.0f);
+    std::fill(age.begin(), age.end(), 0);
+}
+
+void TemporalFilter::apply(const float* depth, float* filtered, WorkerPool* pool)
+{
+    size_t count = smoothed.size();
+    if (pool) {
+        pool->parallelFor(count, [&](size_t begin, size_t end) { apply(depth, filtered, begin, end); }, width);
+    }
+    else {
+        apply(depth, filtered, 0, count);
+    }
+}
+
+void TemporalFilter::apply(const float* depth, float* filtered, size_t begin, size_t end)
+{
+    float* state = smoothed.data();
+    unsigned char* ages = age.data();
+    float inverseThreshold = motionThreshold > 0 ? 1.0f / motionThreshold : 0.0f;
+    unsigned char hold = (unsigned char)std::min(std::max(holdFrames, 0), 255);
+    
+    for (size_t i = begin; i < end; i++) {
+        float value = depth[i];
+        float previous = state[i];
+        if (value > 0) {
+            float difference = std::fabs(value - previous);
+            if (previous <= 0 || difference >= motionThreshold) {
+                previous = value;
+            }
+            else {
+                float weight = alpha + (1.0f - alpha) * difference * inverseThreshold;
+                previous += weight * (value - previous);
+            }
+            ages[i] = 0;
+        }
+        else if (previous > 0 && ages[i] < hold) {
+            ages[i]++;
+        }
+        else {
+            previous = 0;
+        }
+        state[i] = previous;
+        filtered[i] = previous;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class WorkerPool;
+
+// Exponential smoothing of depth over time, to take the flicker out of edges
+// before anything is published.
+//
+// Each pixel moves towards the new value by alpha, raised towards 1 as the
+// difference grows so real motion isn't smeared; beyond the motion threshold
+// the pixel jumps straight to the new value. A pixel that drops out (0) keeps
+// its last value for holdFrames frames before it becomes a hole.
+//
+// The state is one smoothed plane and one age plane, allocated in setup().
+// Pixels are independent, so the work is split into row bands.
+
+class TemporalFilter {
+public:
+    void setup(int width, int height);
+    void reset();
+    
+    void setAlpha(float alpha) { this->alpha = alpha; }
+    // millimetres
+    void setMotionThreshold(float threshold) { motionThreshold = threshold; }
+    void setHoldFrames(int frames) { holdFrames = frames; }
+    
+    float getAlpha() const { return alpha; }
+    float getMotionThreshold() const { return motionThreshold; }
+    int getHoldFrames() const { return holdFrames; }
+    
+    // filters a frame of millimetres into filtered and advances the state,
+    // pool may be null to run on the calling thread
+    void apply(const float* depth, float* filtered, WorkerPool* pool);
+    // same for pixels [begin, end) only
+    void apply(const float* depth, float* filtered, size_t begin, size_t end);
+    
+private:
+    int width = 0;
+    int height = 0;
+    float alpha = 0.3f;
+    float motionThreshold = 100.0f;
+    int holdFrames = 3;
+    
+    std::vector<float> smoothed;
+    std::vector<unsigned char> age;
+};
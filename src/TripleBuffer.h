@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single producer / single consumer triple buffer.
+//
+// The writer fills the back slot and swaps it into the middle, the reader
+// swaps the middle into the front whenever a newer slot is waiting. Neither
+// side ever blocks, and the slots themselves are never reallocated so they
+// can be preallocated once before the producer starts.
+
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+    : front(0)
+    , middle(1)
+    , back(2)
+    {
+    }
+    
+    // producer side
+    T& getWriteSlot() {
+        return slots[back];
+    }
+    
+    void publish() {
+        int previous = middle.exchange(back | NEW_FRAME, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+    
+    // consumer side, returns true if the front slot was replaced by a newer one
+    bool update() {
+        if (!(middle.load(std::memory_order_acquire) & NEW_FRAME)) {
+            return false;
+        }
+        int previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+    
+    const T& getReadSlot() const {
+        return slots[front];
+    }
+    
+    // only safe before the producer has started
+    T& getSlot(int index) {
+        return slots[index];
+    }
+    
+    static const int NUM_SLOTS = 3;
+    
+private:
+    static const int INDEX_MASK = 0x3;
+    static const int NEW_FRAME = 0x4;
+    
+    T slots[NUM_SLOTS];
+    int front;
+    std::atomic<int> middle;
+    int back;
+};
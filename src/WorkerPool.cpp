@@ -0,0 +1,81 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads)
+{
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const Task& task, size_t alignment)
+{
+    size_t threads = getThreadCount();
+    size_t chunk = (count + threads - 1) / threads;
+    chunk = (chunk + alignment - 1) / alignment * alignment;
+    if (workers.empty() || chunk >= count) {
+        task(0, count);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        this->chunk = chunk;
+        remaining = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    
+    task(0, chunk);
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining == 0; });
+    this->task = nullptr;
+}
+
+void WorkerPool::workerLoop(int index)
+{
+    unsigned seen = 0;
+    while (true) {
+        const Task* task;
+        size_t begin, end;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            task = this->task;
+            begin = std::min(count, index * chunk);
+            end = std::min(count, begin + chunk);
+        }
+        
+        if (begin < end) {
+            (*task)(begin, end);
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) {
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for splitting per-pixel work. parallelFor() cuts a
+// range into one contiguous chunk per thread, runs the first chunk on the
+// calling thread and returns once every chunk is done. The threads sleep
+// between calls, nothing is allocated per call.
+
+class WorkerPool {
+public:
+    typedef std::function<void(size_t begin, size_t end)> Task;
+    
+    // 0 uses one thread per hardware thread
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+    
+    int getThreadCount() const { return (int)workers.size() + 1; }
+    
+    // chunk boundaries are multiples of alignment (except the end of the
+    // range), so threads writing bytes don't share cache lines
+    void parallelFor(size_t count, const Task& task, size_t alignment = 64);
+    
+private:
+    void workerLoop(int index);
+    
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    
+    const Task* task = nullptr;
+    size_t count = 0;
+    size_t chunk = 0;
+    unsigned generation = 0;
+    int remaining = 0;
+    bool stopping = false;
+};
@@ -1,8 +1,35 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "ofAppNoWindow.h"
+#include "PixelKernels.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+    
+    // HEADLESS can come from settings.xml or from --headless on the command line
+    ofxXmlSettings XML;
+    XML.loadFile("settings.xml");
+    bool headless = XML.getValue("HEADLESS", 0);
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--headless") {
+            headless = true;
+        }
+        // checks the CPU depth/IR kernels against the shader math and exits
+        if (string(argv[i]) == "--selftest") {
+            string report;
+            bool ok = PixelKernels::verify(report);
+            cout << report;
+            return ok ? 0 : 1;
+        }
+    }
+    
+    if (headless) {
+        // no window and no GL context, ofApp runs capture and conversion only
+        shared_ptr<ofAppNoWindow> window = make_shared<ofAppNoWindow>();
+        ofRunApp(window, make_shared<ofApp>(true));
+        return ofRunMainLoop();
+    }
+    
     ofSetupOpenGL(300,100,OF_WINDOW);			// <-------- setup the GL context
     
     // this kicks off the running of my app
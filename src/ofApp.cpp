@@ -1,24 +1,22 @@
 
 #include "ofApp.h"
+#include "PixelKernels.h"
 
 
 #define STRINGIFY(x) #x
 
+// depth goes through the DepthMapping table, stored as a 256x256 float texture
+// indexed by the integer millimetre value
 static string depthFragmentShader =
 STRINGIFY(
           uniform sampler2DRect tex;
+          uniform sampler2DRect lut;
           void main()
           {
               vec4 col = texture2DRect(tex, gl_TexCoord[0].xy);
-              float value = col.r;
-              float low1 = 500.0;
-              float high1 = 5000.0;
-              float low2 = 1.0;
-              float high2 = 0.0;
-              float d = clamp(low2 + (value - low1) * (high2 - low2) / (high1 - low1), 0.0, 1.0);
-              if (d == 1.0) {
-                  d = 0.0;
-              }
+              float value = clamp(floor(col.r), 0.0, 65535.0);
+              vec2 index = vec2(mod(value, 256.0), floor(value / 256.0)) + 0.5;
+              float d = texture2DRect(lut, index).r;
               gl_FragColor = vec4(vec3(d), 1.0);
           }
           );
@@ -36,101 +34,138 @@ STRINGIFY(
 
 //========================================================================
 
+ofApp::ofApp(bool headless)
+: headless(headless)
+, cpuConversion(headless)
+, headlessFrames(0)
+, headlessReportTime(0)
+{
+}
+
 void ofApp::setup()
 {
     
     
     XML.loadFile("settings.xml");
-    openCLDevice= XML.getValue("OPENCLDEVICE", 0);
-    flip= XML.getValue("FLIP", 0);
     minimised = XML.getValue("MINIMISED", 0);
     recievePort	= XML.getValue("RECIEVEPORT", 12334);
     sendPort =XML.getValue("SENDPORT", 12335);
     sendIp = XML.getValue("SENDIP", "127.0.0.1");
-    hasColor = XML.getValue("HAS_COLOUR", 1);
-    hasIr = XML.getValue("HAS_IR", 1);
-    hasDepth = XML.getValue("HAS_DEPTH", 1);
+    alwaysUpload = XML.getValue("ALWAYS_UPLOAD", 0);
+    
+    depthMapping.setRange(XML.getValue("DEPTH_NEAR", 500.0), XML.getValue("DEPTH_FAR", 5000.0));
+    depthMapping.setInvert(XML.getValue("DEPTH_INVERT", 1));
+    DepthMapping::Curve curve;
+    if (DepthMapping::parseCurve(XML.getValue("DEPTH_CURVE", "linear"), curve)) {
+        depthMapping.setCurve(curve);
+    }
+    else {
+        ofLogWarning() << "unknown DEPTH_CURVE, using linear";
+    }
+    if (depthMapping.getCurve() == DepthMapping::CURVE_LUT && !depthMapping.loadCurveFile(ofToDataPath(XML.getValue("DEPTH_CURVE_FILE", "depthcurve.txt")))) {
+        ofLogWarning() << "could not load DEPTH_CURVE_FILE, using linear";
+        depthMapping.setCurve(DepthMapping::CURVE_LINEAR);
+    }
+    depthMapping.update();
+    
+    filterPool.reset(new WorkerPool(XML.getValue("FILTER_THREADS", 0)));
+    cpuConversion = headless || XML.getValue("CPU_CONVERSION", 0);
+    
+    PixelKernels::Isa isa;
+    if (!PixelKernels::parseIsa(XML.getValue("CPU_KERNELS", "auto"), isa)) {
+        ofLogWarning() << "unknown CPU_KERNELS, using " << PixelKernels::getIsaName(PixelKernels::getBestIsa());
+        isa = PixelKernels::getBestIsa();
+    }
+    PixelKernels::setIsa(isa);
+    if (cpuConversion) {
+        ofLogNotice() << "converting depth and IR on the CPU with " << PixelKernels::getIsaName(PixelKernels::getIsa()) << " kernels";
+    }
     receiver.setup(recievePort);
     sender.setup(sendIp, sendPort);
+    stats.setup(XML.getValue("STATS_INTERVAL", 1.0));
     
     ofSetVerticalSync(true);
     ofSetFrameRate(60);
     
-    if (hasDepth) {
+    // the shaders and the depth table are shared by every sensor
+    if (!cpuConversion) {
         depthShader.setupShaderFromSource(GL_FRAGMENT_SHADER, depthFragmentShader);
         depthShader.linkProgram();
-    }
-    if (hasIr) {
+        depthLutPixels.allocate(256, 256, 1);
+        updateDepthLut();
         irShader.setupShaderFromSource(GL_FRAGMENT_SHADER, irFragmentShader);
         irShader.linkProgram();
     }
-    if (hasDepth||hasIr) {
-        kinect.open(hasColor, true, 0, openCLDevice);
-    }
-    if (!hasDepth && !hasIr) {
-        kinect.open(hasColor, false, 0, openCLDevice);
-    }
-
-    
-    
     
+    shared.headless = headless;
+    shared.cpuConversion = cpuConversion;
+    shared.alwaysUpload = alwaysUpload;
+    shared.minimised = minimised;
+    shared.stats = &stats;
+    shared.pool = filterPool.get();
+    shared.depthMapping = &depthMapping;
+    shared.depthShader = &depthShader;
+    shared.irShader = &irShader;
+    shared.depthLutTex = &depthLutTex;
+    shared.sender = &sender;
+    fusion.reset(new FusionOutput(shared));
+    fusion->setup(XML);
+    shared.fusion = fusion->isEnabled();
     
-    // Note :
-    // Default OpenCL device might not be optimal.
-    // e.g. Intel HD Graphics will be chosen instead of GeForce.
-    // To avoid it, specify OpenCL device index manually like following.
-    // kinect1.open(true, true, 0, 2); // GeForce on MacBookPro Retina
-    
-    kinect.start();
-    
-    if (hasColor) {
-        colourSyphon.setName("KinectV2 Colour");
-    }
-    if (hasDepth) {
-        depthSyphon.setName("KinectV2 Depth");
-        depthFbo.allocate(512, 424);
+    // <SENSORS><SENSOR>...</SENSOR>...</SENSORS> lists the sensors, without
+    // it the top level settings describe one
+    int sensorCount = 0;
+    if (XML.pushTag("SENSORS")) {
+        sensorCount = XML.getNumTags("SENSOR");
+        XML.popTag();
     }
-    if (hasIr) {
-        iRSyphon.setName("KinectV2 IR");
-        irFbo.allocate(512, 424);
-    }
-    if (minimised) {
-        ofSetWindowShape(1024, 50);
+    for (int i = 0; i < max(sensorCount, 1); i++) {
+        sensors.push_back(unique_ptr<Sensor>(new Sensor(shared)));
+        sensors.back()->setup(XML, sensorCount ? i : -1);
     }
-    if (!minimised) {
-        ofSetWindowShape(640+512+512, 424);
+    fusion->setSensors(sensors);
+    if (headless) {
+        ofLogNotice() << "running headless, no preview or syphon output";
+        return;
     }
+    resizeWindow();
 }
 
 void ofApp::update() {
-    kinect.update();
-    if (kinect.isFrameNew()) {
-        
-        if (hasColor) {
-            colorTex.loadData(kinect.getColorPixelsRef());
-        }
-        if (hasDepth) {
-            depthTex.loadData(kinect.getDepthPixelsRef());
-        }
-        if (hasIr) {
-            irTex.loadData(kinect.getIrPixelsRef());
+    for (size_t i = 0; i < sensors.size(); i++) {
+        if (sensors[i]->update()) {
+            fusion->addFrame(i);
+            headlessFrames += headless;
         }
     }
+    fusion->update();
+    
+    // without a window the frame rate goes to the log instead of the screen
+    if (headless && ofGetElapsedTimef() - headlessReportTime > 5) {
+        float elapsed = ofGetElapsedTimef() - headlessReportTime;
+        ofLogNotice() << "Frame Rate " << ofGetFrameRate() << ", Kinect frames/s " << headlessFrames / elapsed;
+        headlessFrames = 0;
+        headlessReportTime = ofGetElapsedTimef();
+    }
     
     while(receiver.hasWaitingMessages()){
+        ScopedTimer timer(stats.get(FrameStats::STAGE_OSC));
         ofxOscMessage m;
         receiver.getNextMessage(&m);
         
-        if ( m.getAddress() == "/minimise" ){
+        // /sensor/<index>/... goes to one sensor, anything else the app does
+        // not handle itself to all of them
+        string address = m.getAddress();
+        int target = -1;
+        if (address.find("/sensor/") == 0) {
+            size_t end = address.find('/', 8);
+            target = ofToInt(address.substr(8, end == string::npos ? string::npos : end - 8));
+            address = end == string::npos ? "" : address.substr(end);
+        }
+        
+        if ( address == "/minimise" ){
             minimised=m.getArgAsInt32(0);
-            
-            if (minimised) {
-                ofSetWindowShape(1024, 50);
-            }
-            if (!minimised) {
-                ofSetWindowShape(640+512+512, 424);
-            }
-            
+            resizeWindow();
             
             ofxOscMessage  myMessage;
             myMessage.setAddress("/minimise");
@@ -138,75 +173,113 @@ void ofApp::update() {
             sender.sendMessage(myMessage);
         }
         
-        if ( m.getAddress() == "/flip" ){
-            flip=m.getArgAsInt32(0);
+        if ( address == "/depth/near" ){
+            depthMapping.setNear(m.getArgAsFloat(0));
+            ofxOscMessage  myMessage;
+            myMessage.setAddress("/depth/near");
+            myMessage.addFloatArg(depthMapping.getNear());
+            sender.sendMessage(myMessage);
+        }
+        
+        if ( address == "/depth/far" ){
+            depthMapping.setFar(m.getArgAsFloat(0));
+            ofxOscMessage  myMessage;
+            myMessage.setAddress("/depth/far");
+            myMessage.addFloatArg(depthMapping.getFar());
+            sender.sendMessage(myMessage);
+        }
+        
+        if ( address == "/depth/invert" ){
+            depthMapping.setInvert(m.getArgAsInt32(0));
+            ofxOscMessage  myMessage;
+            myMessage.setAddress("/depth/invert");
+            myMessage.addIntArg(depthMapping.getInvert());
+            sender.sendMessage(myMessage);
+        }
+        
+        if ( address == "/depth/curve" ){
+            DepthMapping::Curve curve;
+            if (DepthMapping::parseCurve(m.getArgAsString(0), curve)) {
+                // a curve file can be sent as the second argument, without
+                // one lut reuses the last file loaded. The reply says which
+                // curve is in use if neither worked
+                if (curve == DepthMapping::CURVE_LUT && m.getNumArgs() > 1) {
+                    if (!depthMapping.loadCurveFile(ofToDataPath(m.getArgAsString(1)))) {
+                        ofLogWarning() << "could not load curve file " << m.getArgAsString(1);
+                    }
+                }
+                else if (curve == DepthMapping::CURVE_LUT && !depthMapping.hasCurvePoints()) {
+                    ofLogWarning() << "/depth/curve lut needs a curve file";
+                }
+                else {
+                    depthMapping.setCurve(curve);
+                }
+            }
             ofxOscMessage  myMessage;
-            myMessage.setAddress("/flip");
-            myMessage.addIntArg(flip);
+            myMessage.setAddress("/depth/curve");
+            myMessage.addStringArg(DepthMapping::getCurveName(depthMapping.getCurve()));
             sender.sendMessage(myMessage);
         }
+        
+        for (size_t i = 0; i < sensors.size(); i++) {
+            if (target < 0 || target == (int)i) {
+                sensors[i]->receive(address, m);
+            }
+        }
+    }
+    
+    if (depthMapping.update() && !cpuConversion) {
+        updateDepthLut();
     }
+    
+    stats.update(sender);
 }
 
 void ofApp::draw()
 {
-    ofClear(0);
-    
-    
-    if (hasColor) {
-        if (colorTex.isAllocated()) {
-            if (!minimised) {
-                colorTex.draw(0, 0, 640, 360);
-            }
-            colourSyphon.publishTexture(&colorTex);
-        }
+    if (headless) {
+        return;
     }
     
-    
-    if (depthTex.isAllocated()) {
-        if (hasDepth) {
-            depthFbo.begin();
-            ofClear(0, 0, 0);
-            depthShader.begin();
-            depthTex.draw(0, 0, 512, 424);
-            depthShader.end();
-            depthFbo.end();
-            depthSyphon.publishTexture(&depthFbo.getTexture());
-            if (!minimised) {
-                depthFbo.draw(640, 0, 512, 424);
-            }
-        }
-        
-        if (hasIr) {
-            irFbo.begin();
-            ofClear(0,0,0);
-            irShader.begin();
-            irTex.draw(0, 0, 512, 424);
-            irShader.end();
-            irFbo.end();
-            iRSyphon.publishTexture(&irFbo.getTexture());
-            if (!minimised) {
-                irFbo.draw(1152, 0, 512, 424);
-            }
-        }
+    ofClear(0);
+    // a row of previews per sensor
+    for (size_t i = 0; i < sensors.size(); i++) {
+        sensors[i]->draw(i * 424);
     }
+    fusion->draw();
     
     ofPushStyle();
     ofDrawBitmapStringHighlight("Frame Rate " + ofToString(ofGetFrameRate()), 10, 20);
-    ofDrawBitmapStringHighlight("OpenCL Device : " + ofToString(openCLDevice), 10, 40);
+    ofDrawBitmapStringHighlight("Frames dropped " + ofToString(stats.getTotal(FrameStats::COUNTER_DROPPED)) + " duplicated " + ofToString(stats.getTotal(FrameStats::COUNTER_DUPLICATED)), 300, 40);
     ofPopStyle();
     
     
 }
 
+void ofApp::updateDepthLut()
+{
+    memcpy(depthLutPixels.getData(), depthMapping.getUnitTable(), DepthMapping::TABLE_SIZE * sizeof(float));
+    depthLutTex.loadData(depthLutPixels);
+    depthLutTex.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+}
+
+void ofApp::resizeWindow()
+{
+    shared.minimised = minimised;
+    if (minimised) {
+        ofSetWindowShape(1024, 50);
+    }
+    if (!minimised) {
+        ofSetWindowShape(640+512+512, 424 * sensors.size());
+    }
+}
+
 void ofApp::keyPressed(int key)
 {
     if (key == 'f') {
-        kinect.setEnableFlipBuffer(!kinect.isEnableFlipBuffer());
-        ofxOscMessage  myMessage;
-        myMessage.setAddress("/flip");
-        myMessage.addIntArg(flip);
-        sender.sendMessage(myMessage);
+        for (unique_ptr<Sensor>& sensor : sensors) {
+            sensor->toggleFlip();
+        }
     }
     
     if (key == 'm') {
@@ -216,17 +289,37 @@ void ofApp::keyPressed(int key)
         myMessage.addIntArg(minimised);
         sender.sendMessage(myMessage);
         
-        if (minimised) {
-            ofSetWindowShape(1024, 50);
+        resizeWindow();
+    }
+    
+    if (key == 'b') {
+        for (unique_ptr<Sensor>& sensor : sensors) {
+            sensor->learnBackground();
         }
-        if (!minimised) {
-            ofSetWindowShape(640+512+512, 424);
+    }
+    
+    // all sensors start and stop together
+    if (key == 'r') {
+        bool recording = false;
+        for (unique_ptr<Sensor>& sensor : sensors) {
+            recording |= sensor->isRecording();
+        }
+        for (unique_ptr<Sensor>& sensor : sensors) {
+            if (recording) {
+                sensor->stopRecording();
+            }
+            else {
+                sensor->startRecording("");
+            }
         }
     }
     
 }
 void ofApp::exit(){
-    kinect.close();
+    for (unique_ptr<Sensor>& sensor : sensors) {
+        sensor->exit();
+    }
+    fusion->exit();
     
 }
 //--------------------------------------------------------------
@@ -1,13 +1,19 @@
 #pragma once
 
 #include "ofMain.h"
-#include "ofxMultiKinectV2.h"
-#include "ofxSyphon.h"
 #include "ofxXmlSettings.h"
 #include "ofxOsc.h"
+#include "DepthMapping.h"
+#include "FrameStats.h"
+#include "FusionOutput.h"
+#include "Sensor.h"
+#include "WorkerPool.h"
 
 class ofApp : public ofBaseApp{
+public:
+    ofApp(bool headless = false);
     
+private:
     void setup();
     void update();
     void draw();
@@ -21,25 +27,42 @@ class ofApp : public ofBaseApp{
     void windowResized(int w, int h);
     void dragEvent(ofDragInfo dragInfo);
     void gotMessage(ofMessage msg);
+    void updateDepthLut();
+    void resizeWindow();
     
     ofShader depthShader;
     ofShader irShader;
     ofxXmlSettings XML;
-    ofxMultiKinectV2 kinect;
-    ofTexture colorTex;
-    ofTexture depthTex;
-    ofTexture irTex;
-    ofxSyphonServer colourSyphon, depthSyphon, iRSyphon;
-    ofFbo irFbo, depthFbo;
-    int openCLDevice;
+    FrameStats stats;
+    DepthMapping depthMapping;
+    ofFloatPixels depthLutPixels;
+    ofTexture depthLutTex;
     bool minimised;
-    bool flip;
     int recievePort;
     
     ofxOscReceiver receiver;
     ofxOscSender sender;
     string sendIp;
     int sendPort;
-    bool hasColor, hasIr, hasDepth;
+    
+    // headless mode runs without a GL context, conversions happen on the CPU
+    bool headless;
+    bool cpuConversion;
+    int headlessFrames;
+    float headlessReportTime;
+    
+    // streams nobody watches are neither converted nor uploaded
+    bool alwaysUpload;
+    
+    // filters and conversions of every sensor are split over one pool
+    unique_ptr<WorkerPool> filterPool;
+    
+    // one per SENSOR in settings.xml, or one from the top level settings,
+    // all seeing the app's state through shared
+    Sensor::Shared shared;
+    vector<unique_ptr<Sensor>> sensors;
+    
+    // the sensors' depth merged into one height map and point cloud
+    unique_ptr<FusionOutput> fusion;
    
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+// Receives the app's network outputs (NET_STREAMS) and prints what arrives
+// once a second: the format and frames/s of each stream, frames lost on
+// the way and frames that arrived incomplete. Doubles as an example
+// of using NetworkReceiver.
+//
+//   make && ./kinectrecv [options]
+//
+//   --port 12340           NET_PORT of the app
+//   --tcp                  NET_PROTOCOL tcp, default udp
+//   --seconds 10           stop after this long, default run until killed
+
+#include "NetworkReceiver.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+    struct Options {
+        int port = 12340;
+        NetworkReceiver::Protocol protocol = NetworkReceiver::PROTOCOL_UDP;
+        double seconds = 0;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--port" && hasValue) {
+                options.port = atoi(argv[++i]);
+            }
+            else if (arg == "--tcp") {
+                options.protocol = NetworkReceiver::PROTOCOL_TCP;
+            }
+            else if (arg == "--seconds" && hasValue) {
+                options.seconds = atof(argv[++i]);
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct StreamReport {
+        FrameFormat format;
+        int frames = 0;
+    };
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--port n] [--tcp] [--seconds s]\n", argv[0]);
+        return 1;
+    }
+    NetworkReceiver receiver;
+    if (!receiver.open(options.port, options.protocol)) {
+        fprintf(stderr, "could not listen on port %d\n", options.port);
+        return 1;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point reportTime = start;
+    map<string, StreamReport> reports;
+    NetworkReceiver::Stats reported;
+    NetworkReceiver::Frame frame;
+    while (!options.seconds || chrono::duration<double>(chrono::steady_clock::now() - start).count() < options.seconds) {
+        if (receiver.receive(frame, 100)) {
+            StreamReport& report = reports[frame.stream];
+            report.format = frame.format;
+            report.frames++;
+        }
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - reportTime).count();
+        if (elapsed >= 1) {
+            const NetworkReceiver::Stats& stats = receiver.getStats();
+            for (auto& report : reports) {
+                printf("%-16s %ux%u %-7s %5.1f fps\n", report.first.c_str(), report.second.format.width, report.second.format.height,
+                       FrameTransportFormat::getName(report.second.format.pixelFormat).c_str(), report.second.frames / elapsed);
+                report.second.frames = 0;
+            }
+            printf("%llu lost, %llu incomplete, %llu bad\n",
+                   (unsigned long long)(stats.lostFrames - reported.lostFrames),
+                   (unsigned long long)(stats.incompleteFrames - reported.incompleteFrames),
+                   (unsigned long long)(stats.badPackets - reported.badPackets));
+            reported = stats;
+            reportTime = now;
+        }
+    }
+    return 0;
+}
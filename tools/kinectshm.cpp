@@ -0,0 +1,134 @@
+// Reads a stream the app publishes to shared memory (SHM_STREAMS) and
+// prints what arrives once a second: format, frames/s, frames the reader
+// missed, torn frames and the latency from capture. Doubles as an example
+// of a zero-copy reader.
+//
+//   make && ./kinectshm [options] stream
+//
+//   --prefix kinectv2      SHM_PREFIX of the app
+//   --seconds 10           stop after this long, default run until killed
+//   --poll 1               ms to sleep between looks at the ring
+
+#include "SharedMemoryRing.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+    struct Options {
+        string prefix = "kinectv2";
+        string stream;
+        double seconds = 0;
+        int poll = 1;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--prefix" && hasValue) {
+                options.prefix = argv[++i];
+            }
+            else if (arg == "--seconds" && hasValue) {
+                options.seconds = atof(argv[++i]);
+            }
+            else if (arg == "--poll" && hasValue) {
+                options.poll = atoi(argv[++i]);
+            }
+            else if (arg[0] != '-' && options.stream.empty()) {
+                options.stream = arg;
+            }
+            else {
+                return false;
+            }
+        }
+        return !options.stream.empty();
+    }
+
+    // something that touches every pixel, as a consumer would
+    unsigned checksum(const unsigned char* pixels, size_t size)
+    {
+        unsigned sum = 0;
+        for (size_t i = 0; i < size; i += 64) {
+            sum += pixels[i];
+        }
+        return sum;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--prefix name] [--seconds s] [--poll ms] stream\n", argv[0]);
+        return 1;
+    }
+    string name = SharedMemoryRing::getObjectName(options.prefix, options.stream);
+    SharedMemoryRing::Reader reader;
+    uint64_t start = SharedMemoryRing::now();
+    uint64_t reportTime = start;
+    uint64_t last = 0;
+    bool hasLast = false;
+    int frames = 0, missed = 0, torn = 0;
+    uint64_t latency = 0;
+    unsigned sum = 0;
+
+    while (!options.seconds || SharedMemoryRing::now() - start < options.seconds * 1e9) {
+        if (!reader.isOpen() || reader.isWriterClosed()) {
+            if (reader.isOpen()) {
+                printf("%s closed\n", name.c_str());
+                reader.close();
+                hasLast = false;
+            }
+            if (!reader.open(name)) {
+                this_thread::sleep_for(chrono::milliseconds(100));
+                continue;
+            }
+            FrameFormat format = reader.getFormat();
+            printf("%s: %ux%u %s\n", name.c_str(), format.width, format.height, FrameTransportFormat::getName(format.pixelFormat).c_str());
+        }
+
+        SharedMemoryRing::Frame frame;
+        uint64_t count = reader.getFrameCount();
+        if (count && (!hasLast || count - 1 != last)) {
+            if (reader.acquire(frame)) {
+                sum += checksum(frame.pixels, reader.getFormat().getSize());
+                if (reader.release(frame)) {
+                    if (hasLast) {
+                        missed += frame.frame - last - 1;
+                    }
+                    last = frame.frame;
+                    hasLast = true;
+                    frames++;
+                    latency += SharedMemoryRing::now() - frame.timestamp;
+                }
+                else {
+                    torn++;
+                }
+            }
+            else {
+                torn++;
+            }
+        }
+
+        uint64_t now = SharedMemoryRing::now();
+        if (now - reportTime >= 1000000000) {
+            double elapsed = (now - reportTime) / 1e9;
+            printf("%.1f fps, %d missed, %d torn, %.2f ms latency (%08x)\n", frames / elapsed, missed, torn,
+                   frames ? latency / 1e6 / frames : 0.0, sum);
+            frames = missed = torn = 0;
+            latency = 0;
+            reportTime = now;
+        }
+        this_thread::sleep_for(chrono::milliseconds(options.poll));
+    }
+    return 0;
+}